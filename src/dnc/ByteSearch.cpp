@@ -0,0 +1,327 @@
+#include "ByteSearch.hpp"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DNC_BYTE_SIMD
+#endif
+
+using namespace std;
+
+namespace dnc
+{
+   namespace
+   {
+      typedef uint64_t (*FindFunction)(const uint8_t*, uint64_t, uint64_t, const uint8_t*, const uint8_t*, const uint64_t*);
+
+      uint64_t findScalar(const uint8_t* data, uint64_t size, uint64_t pos, const uint64_t* bytes)
+      {
+         for(; pos < size; ++pos)
+         {
+            uint8_t c = data[pos];
+            if(bytes[c / 64] & (uint64_t(1) << (c % 64)))
+            {
+               return pos;
+            }
+         }
+         return size;
+      }
+
+      uint64_t findDefault(const uint8_t* data, uint64_t size, uint64_t pos, const uint8_t*, const uint8_t*, const uint64_t* bytes)
+      {
+         return findScalar(data, size, pos, bytes);
+      }
+
+#ifdef DNC_BYTE_SIMD
+      __attribute__((target("ssse3")))
+      uint64_t findSSE(const uint8_t* data, uint64_t size, uint64_t pos, const uint8_t* ascii, const uint8_t* upper, const uint64_t* bytes)
+      {
+         const __m128i ascii_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii));
+         const __m128i upper_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper));
+         const __m128i bit_table = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128));
+         const __m128i low_mask = _mm_set1_epi8(0x0F);
+         const __m128i high_bit = _mm_set1_epi8(char(0x80));
+         const __m128i zero = _mm_setzero_si128();
+
+         for(; pos + 16 <= size; pos += 16)
+         {
+            __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+
+            /*
+               pshufb devuelve cero en los bytes con el bit 7 activo, así que
+               cada tabla solo responde por su mitad de los valores.
+            */
+            __m128i row = _mm_or_si128(
+               _mm_shuffle_epi8(ascii_table, input),
+               _mm_shuffle_epi8(upper_table, _mm_xor_si128(input, high_bit))
+            );
+            __m128i column = _mm_shuffle_epi8(bit_table, _mm_and_si128(_mm_srli_epi16(input, 4), low_mask));
+
+            uint32_t found = uint32_t(~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, column), zero))) & 0xFFFF;
+            if(found != 0)
+            {
+               return pos + __builtin_ctz(found);
+            }
+         }
+
+         return findScalar(data, size, pos, bytes);
+      }
+
+      __attribute__((target("avx2")))
+      uint64_t findAVX2(const uint8_t* data, uint64_t size, uint64_t pos, const uint8_t* ascii, const uint8_t* upper, const uint64_t* bytes)
+      {
+         const __m256i ascii_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii)));
+         const __m256i upper_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(upper)));
+         const __m256i bit_table = _mm256_setr_epi8(
+            1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128),
+            1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128)
+         );
+         const __m256i low_mask = _mm256_set1_epi8(0x0F);
+         const __m256i high_bit = _mm256_set1_epi8(char(0x80));
+         const __m256i zero = _mm256_setzero_si256();
+
+         for(; pos + 32 <= size; pos += 32)
+         {
+            __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+
+            __m256i row = _mm256_or_si256(
+               _mm256_shuffle_epi8(ascii_table, input),
+               _mm256_shuffle_epi8(upper_table, _mm256_xor_si256(input, high_bit))
+            );
+            __m256i column = _mm256_shuffle_epi8(bit_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), low_mask));
+
+            uint32_t found = ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, column), zero)));
+            if(found != 0)
+            {
+               return pos + __builtin_ctz(found);
+            }
+         }
+
+         return findSSE(data, size, pos, ascii, upper, bytes);
+      }
+#endif
+
+      typedef uint64_t (*FindStringFunction)(const char*, uint64_t, uint64_t, const char*, uint64_t);
+
+      uint64_t findStringDefault(const char* data, uint64_t size, uint64_t pos, const char* value, uint64_t value_size)
+      {
+#ifdef __GLIBC__
+         const void* found = memmem(data + pos, size - pos, value, value_size);
+         if(found == nullptr)
+         {
+            return size;
+         }
+         return static_cast<const char*>(found) - data;
+#else
+         size_t found = string_view(data, size).find(string_view(value, value_size), pos);
+         return found == string_view::npos ? size : found;
+#endif
+      }
+
+#ifdef DNC_BYTE_SIMD
+      /*
+         Se comparan a la vez el primer y el último byte de value en cada
+         posición del bloque y solo se verifica el resto donde ambos
+         coinciden.
+      */
+      __attribute__((target("sse2")))
+      uint64_t findStringSSE(const char* data, uint64_t size, uint64_t pos, const char* value, uint64_t value_size)
+      {
+         const __m128i first = _mm_set1_epi8(value[0]);
+         const __m128i last = _mm_set1_epi8(value[value_size - 1]);
+
+         for(; pos + value_size - 1 + 16 <= size; pos += 16)
+         {
+            __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + value_size - 1));
+
+            uint32_t found = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+            while(found != 0)
+            {
+               uint32_t offset = __builtin_ctz(found);
+               if(memcmp(data + pos + offset + 1, value + 1, value_size - 1) == 0)
+               {
+                  return pos + offset;
+               }
+               found &= found - 1;
+            }
+         }
+
+         return findStringDefault(data, size, pos, value, value_size);
+      }
+
+      __attribute__((target("avx2")))
+      uint64_t findStringAVX2(const char* data, uint64_t size, uint64_t pos, const char* value, uint64_t value_size)
+      {
+         const __m256i first = _mm256_set1_epi8(value[0]);
+         const __m256i last = _mm256_set1_epi8(value[value_size - 1]);
+
+         for(; pos + value_size - 1 + 32 <= size; pos += 32)
+         {
+            __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+            __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + value_size - 1));
+
+            uint32_t found = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+            while(found != 0)
+            {
+               uint32_t offset = __builtin_ctz(found);
+               if(memcmp(data + pos + offset + 1, value + 1, value_size - 1) == 0)
+               {
+                  return pos + offset;
+               }
+               found &= found - 1;
+            }
+         }
+
+         return findStringSSE(data, size, pos, value, value_size);
+      }
+#endif
+
+      FindFunction selectFind()
+      {
+#ifdef DNC_BYTE_SIMD
+         __builtin_cpu_init();
+         if(__builtin_cpu_supports("avx2")) return findAVX2;
+         if(__builtin_cpu_supports("ssse3")) return findSSE;
+#endif
+         return findDefault;
+      }
+
+      FindStringFunction selectFindString()
+      {
+#ifdef DNC_BYTE_SIMD
+         __builtin_cpu_init();
+         if(__builtin_cpu_supports("avx2")) return findStringAVX2;
+         if(__builtin_cpu_supports("sse2")) return findStringSSE;
+#endif
+         return findStringDefault;
+      }
+   }
+
+   ByteSearch::ByteSearch()
+   {
+      clear();
+   }
+
+   void ByteSearch::add(uint8_t byte)
+   {
+      if(contains(byte))
+      {
+         return;
+      }
+
+      bytes[byte / 64] |= uint64_t(1) << (byte % 64);
+      count += 1;
+
+      uint8_t* table = byte < 128 ? ascii_table : upper_table;
+      table[byte & 0x0F] |= uint8_t(1 << ((byte >> 4) & 7));
+   }
+
+   void ByteSearch::addRange(uint8_t min, uint8_t max)
+   {
+      for(uint32_t byte = min; byte <= max; ++byte)
+      {
+         add(byte);
+      }
+   }
+
+   void ByteSearch::remove(uint8_t byte)
+   {
+      if(!contains(byte))
+      {
+         return;
+      }
+
+      bytes[byte / 64] &= ~(uint64_t(1) << (byte % 64));
+      count -= 1;
+
+      uint8_t* table = byte < 128 ? ascii_table : upper_table;
+      table[byte & 0x0F] &= uint8_t(~(1 << ((byte >> 4) & 7)));
+   }
+
+   void ByteSearch::clear()
+   {
+      memset(bytes, 0, sizeof(bytes));
+      memset(ascii_table, 0, sizeof(ascii_table));
+      memset(upper_table, 0, sizeof(upper_table));
+      count = 0;
+   }
+
+   bool ByteSearch::contains(uint8_t byte) const
+   {
+      return bytes[byte / 64] & (uint64_t(1) << (byte % 64));
+   }
+
+   uint32_t ByteSearch::size() const
+   {
+      return count;
+   }
+
+   uint64_t ByteSearch::find(string_view text, uint64_t pos) const
+   {
+      if(pos >= text.size() || count == 0)
+      {
+         return text.size();
+      }
+
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+      /*
+         Con conjuntos grandes lo más común es que el primer byte ya sirva.
+      */
+      if(contains(data[pos]))
+      {
+         return pos;
+      }
+
+      if(count == 1)
+      {
+         uint8_t byte = 0;
+         for(uint32_t i = 0; i < 4; ++i)
+         {
+            if(bytes[i] != 0)
+            {
+               byte = uint8_t(i * 64 + __builtin_ctzll(bytes[i]));
+               break;
+            }
+         }
+
+         const void* found = memchr(data + pos, byte, text.size() - pos);
+         if(found == nullptr)
+         {
+            return text.size();
+         }
+         return static_cast<const uint8_t*>(found) - data;
+      }
+
+      static const FindFunction function = selectFind();
+      return function(data, text.size(), pos, ascii_table, upper_table, bytes);
+   }
+
+   uint64_t ByteSearch::findString(string_view text, uint64_t pos, string_view value)
+   {
+      if(pos > text.size() || value.size() > text.size() - pos)
+      {
+         return text.size();
+      }
+
+      if(value.size() == 0)
+      {
+         return pos;
+      }
+
+      if(value.size() == 1)
+      {
+         const void* found = memchr(text.data() + pos, value[0], text.size() - pos);
+         if(found == nullptr)
+         {
+            return text.size();
+         }
+         return static_cast<const char*>(found) - text.data();
+      }
+
+      static const FindStringFunction function = selectFindString();
+      return function(text.data(), text.size(), pos, value.data(), value.size());
+   }
+}
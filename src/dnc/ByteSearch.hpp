@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace dnc
+{
+   /*
+      Conjunto de bytes con búsqueda de la primera posición del texto cuyo
+      byte pertenece a él. Con un solo byte se usa memchr(); si no, una
+      búsqueda por tablas de nibbles con instrucciones SSSE3 o AVX2 cuando el
+      procesador las tiene.
+   */
+   class ByteSearch
+   {
+   public:
+      /*
+         Empieza vacío.
+      */
+      ByteSearch();
+
+      void add(uint8_t byte);
+      void addRange(uint8_t min, uint8_t max);
+      void remove(uint8_t byte);
+      void clear();
+
+      bool contains(uint8_t byte) const;
+      uint32_t size() const;
+
+      /*
+         Devuelve la primera posición desde pos cuyo byte pertenece al
+         conjunto, o el tamaño del texto si no hay ninguna.
+      */
+      uint64_t find(std::string_view text, uint64_t pos) const;
+
+      /*
+         Devuelve la primera posición desde pos donde aparece value, o el
+         tamaño del texto si no aparece. También usa instrucciones
+         vectoriales cuando puede.
+      */
+      static uint64_t findString(std::string_view text, uint64_t pos, std::string_view value);
+
+   private:
+      uint64_t bytes[4];
+      uint32_t count;
+      /*
+         Tablas para la búsqueda vectorizada: para cada nibble bajo, un bit
+         por cada valor de los bits 4 a 6. La primera es para los bytes
+         menores a 128 y la segunda para el resto.
+      */
+      uint8_t ascii_table[16];
+      uint8_t upper_table[16];
+   };
+}
@@ -0,0 +1,249 @@
+#include "CallStack.hpp"
+
+#include <exception>
+
+#ifdef __GLIBC__
+#include <ucontext.h>
+#define DNC_CALL_SEGMENTS
+#endif
+
+using namespace std;
+
+namespace dnc
+{
+   struct CallStack::Segment
+   {
+      char* memory;
+#ifdef DNC_CALL_SEGMENTS
+      ucontext_t context;
+      ucontext_t caller;
+#endif
+      NestedFunction function;
+      const void* function_context;
+      bool result;
+      exception_ptr exception;
+   };
+
+   thread_local CallStack* CallStack::active = nullptr;
+
+   const uint32_t CallStack::DEFAULT_MAX_DEPTH = 10000;
+   const uint64_t CallStack::DEFAULT_SEGMENT_SIZE = 1 << 20;
+   const uint32_t CallStack::NO_SEGMENT = uint32_t(-1);
+   const uint64_t CallStack::RED_ZONE = 64 << 10;
+   const uint64_t CallStack::THREAD_STACK_USE = 64 << 10;
+
+   /*
+      class CallStack::Scope
+   */
+   CallStack::Scope::Scope(CallStack* stack) :
+      outer(false)
+   {
+      if(stack != nullptr && active == nullptr)
+      {
+         stack->reset(reinterpret_cast<uintptr_t>(this));
+         active = stack;
+         outer = true;
+      }
+   }
+
+   CallStack::Scope::~Scope()
+   {
+      if(outer)
+      {
+         active = nullptr;
+      }
+   }
+
+   bool CallStack::Scope::isOuter() const
+   {
+      return outer;
+   }
+
+   bool CallStack::Scope::isExceeded() const
+   {
+      return active != nullptr && active->exceeded;
+   }
+
+   /*
+      class CallStack
+   */
+   CallStack::CallStack(uint32_t max_depth, uint64_t segment_size) :
+      max_depth(max_depth),
+      segment_size(segment_size > 2 * RED_ZONE ? segment_size : 2 * RED_ZONE),
+      current(NO_SEGMENT),
+      thread_base(0),
+      depth(0),
+      depth_reached(0),
+      exceeded(false)
+   {}
+
+   CallStack::~CallStack()
+   {
+      for(auto segment : segments)
+      {
+         delete[] segment->memory;
+         delete segment;
+      }
+   }
+
+   void CallStack::setMaxDepth(uint32_t max_depth)
+   {
+      this->max_depth = max_depth;
+   }
+
+   uint32_t CallStack::getMaxDepth() const
+   {
+      return max_depth;
+   }
+
+   uint32_t CallStack::getDepthReached() const
+   {
+      return depth_reached;
+   }
+
+   bool CallStack::isExceeded() const
+   {
+      return exceeded;
+   }
+
+   uint32_t CallStack::getSegmentCount() const
+   {
+      return segments.size();
+   }
+
+   bool CallStack::nest(NestedFunction function, const void* context)
+   {
+      /*
+         Una vez superada la profundidad, todas las llamadas fallan sin
+         analizar nada, incluidas las que estaban en curso.
+      */
+      if(exceeded)
+      {
+         return false;
+      }
+
+      if(depth >= max_depth)
+      {
+         exceeded = true;
+         return false;
+      }
+
+      depth += 1;
+      if(depth > depth_reached)
+      {
+         depth_reached = depth;
+      }
+
+      bool result;
+      try
+      {
+#ifdef DNC_CALL_SEGMENTS
+         char here;
+         if(hasRoom(reinterpret_cast<uintptr_t>(&here)))
+         {
+            result = function(context);
+         }
+         else result = callOnSegment(function, context);
+#else
+         result = function(context);
+#endif
+      }
+      catch(...)
+      {
+         depth -= 1;
+         throw;
+      }
+
+      depth -= 1;
+      return result && !exceeded;
+   }
+
+   void CallStack::reset(uintptr_t base)
+   {
+      current = NO_SEGMENT;
+      thread_base = base;
+      depth = 0;
+      depth_reached = 0;
+      exceeded = false;
+   }
+
+   bool CallStack::hasRoom(uintptr_t address) const
+   {
+      /*
+         Se mide la distancia al comienzo de la pila actual, sin suponer
+         hacia dónde crece.
+      */
+      uintptr_t base;
+      uint64_t size;
+      if(current == NO_SEGMENT)
+      {
+         base = thread_base;
+         size = THREAD_STACK_USE + RED_ZONE;
+      }
+      else
+      {
+         base = reinterpret_cast<uintptr_t>(segments[current]->memory + segment_size);
+         size = segment_size;
+      }
+
+      uint64_t used = address < base ? base - address : address - base;
+      return used + RED_ZONE < size;
+   }
+
+#ifdef DNC_CALL_SEGMENTS
+   bool CallStack::callOnSegment(NestedFunction function, const void* context)
+   {
+      uint32_t previous = current;
+      uint32_t index = current == NO_SEGMENT ? 0 : current + 1;
+
+      if(index == segments.size())
+      {
+         Segment* segment = new Segment();
+         segment->memory = new char[segment_size];
+         segments.push_back(segment);
+      }
+
+      Segment* segment = segments[index];
+      segment->function = function;
+      segment->function_context = context;
+      segment->result = false;
+      segment->exception = nullptr;
+
+      getcontext(&segment->context);
+      segment->context.uc_stack.ss_sp = segment->memory;
+      segment->context.uc_stack.ss_size = segment_size;
+      segment->context.uc_link = &segment->caller;
+      makecontext(&segment->context, runSegment, 0);
+
+      current = index;
+      swapcontext(&segment->caller, &segment->context);
+      current = previous;
+
+      /*
+         Una excepción no puede salir del tramo, porque su pila no continúa
+         la del que llamó; se guarda allí y se vuelve a lanzar aquí.
+      */
+      if(segment->exception != nullptr)
+      {
+         exception_ptr exception = segment->exception;
+         segment->exception = nullptr;
+         rethrow_exception(exception);
+      }
+
+      return segment->result;
+   }
+
+   void CallStack::runSegment()
+   {
+      Segment* segment = active->segments[active->current];
+      try
+      {
+         segment->result = segment->function(segment->function_context);
+      }
+      catch(...)
+      {
+         segment->exception = current_exception();
+      }
+   }
+#endif
+}
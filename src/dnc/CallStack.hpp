@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace dnc
+{
+   /*
+      Pila de las llamadas anidadas de un análisis (EXP(), las reglas de
+      Grammar y sus operadores) en memoria dinámica. Mientras está activa,
+      cuando a la pila actual le queda poco espacio la llamada sigue en un
+      tramo nuevo de segment_size bytes, así que la profundidad del texto no
+      depende de la pila del hilo. Una llamada a más de max_depth niveles
+      hace fallar todo el análisis, e isExceeded() lo indica.
+
+      Los tramos necesitan makecontext(), que solo se usa con glibc. En las
+      demás plataformas las llamadas siguen en la pila del hilo y solo se
+      aplica max_depth, que entonces tiene que ser acorde a esa pila.
+
+      Una pila no debe usarse desde varios hilos a la vez.
+   */
+   class CallStack
+   {
+   public:
+      /*
+         Activa la pila durante un análisis. Solo el ámbito más externo la
+         instala y la reinicia; los demás no hacen nada.
+      */
+      class Scope
+      {
+      public:
+         Scope(CallStack* stack);
+         ~Scope();
+
+         bool isOuter() const;
+
+         /*
+            Indica si el análisis en curso superó la profundidad máxima.
+         */
+         bool isExceeded() const;
+
+      private:
+         bool outer;
+      };
+
+      static const uint32_t DEFAULT_MAX_DEPTH;
+      static const uint64_t DEFAULT_SEGMENT_SIZE;
+
+      CallStack(uint32_t max_depth = DEFAULT_MAX_DEPTH, uint64_t segment_size = DEFAULT_SEGMENT_SIZE);
+      ~CallStack();
+
+      void setMaxDepth(uint32_t max_depth);
+      uint32_t getMaxDepth() const;
+
+      /*
+         Datos del último análisis: la profundidad más grande a la que se
+         llegó y si se superó la máxima. Los tramos se conservan entre
+         análisis.
+      */
+      uint32_t getDepthReached() const;
+      bool isExceeded() const;
+      uint32_t getSegmentCount() const;
+
+      /*
+         Ejecuta una llamada anidada. Sin una pila activa, la ejecuta
+         directamente. Una excepción de la llamada sale de call() aunque
+         se haya ejecutado en un tramo.
+      */
+      template<typename Function>
+      static bool call(const Function& function);
+
+   private:
+      /*
+         La llamada se pasa como una función y el objeto con el que se
+         llama, para no copiarla en cada nivel.
+      */
+      typedef bool (*NestedFunction)(const void* context);
+
+      /*
+         Tramo de pila y el contexto para pasar a él. Se define junto con el
+         resto del código que depende de la plataforma.
+      */
+      struct Segment;
+
+      static const uint32_t NO_SEGMENT;
+
+      /*
+         Espacio que se deja libre en cada tramo para lo que se ejecuta
+         entre dos llamadas, incluidas las funciones de fábrica, y el que se
+         usa de la pila del hilo antes de pasar al primer tramo.
+      */
+      static const uint64_t RED_ZONE;
+      static const uint64_t THREAD_STACK_USE;
+
+      static thread_local CallStack* active;
+
+      uint32_t max_depth;
+      uint64_t segment_size;
+      std::vector<Segment*> segments;
+      uint32_t current;
+      uintptr_t thread_base;
+      uint32_t depth;
+      uint32_t depth_reached;
+      bool exceeded;
+
+      bool nest(NestedFunction function, const void* context);
+      void reset(uintptr_t base);
+      bool hasRoom(uintptr_t address) const;
+      bool callOnSegment(NestedFunction function, const void* context);
+
+      template<typename Callable>
+      static bool invoke(const void* context);
+
+      static void runSegment();
+   };
+
+   template<typename Function>
+   bool CallStack::call(const Function& function)
+   {
+      if(active == nullptr)
+      {
+         return function();
+      }
+
+      return active->nest(invoke<Function>, &function);
+   }
+
+   template<typename Callable>
+   bool CallStack::invoke(const void* context)
+   {
+      return (*static_cast<const Callable*>(context))();
+   }
+}
@@ -0,0 +1,194 @@
+#include "CharClass.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   const uint32_t CharClass::SMALL_COUNT = 8;
+
+   CharClass::CharClass() :
+      ascii{ 0, 0 }
+   {}
+
+   CharClass::CharClass(uint32_t min, uint32_t max) :
+      ascii{ 0, 0 }
+   {
+      addRange(min, max);
+   }
+
+   void CharClass::addRange(uint32_t min, uint32_t max)
+   {
+      if(max < min)
+      {
+         return;
+      }
+
+      /*
+         Los rangos se mantienen ordenados y sin solapamientos, uniendo
+         también los que son contiguos.
+      */
+      uint32_t i = 0;
+      while(i < ranges.size() && ranges[i].max < min && ranges[i].max + 1 < min)
+      {
+         ++i;
+      }
+
+      uint32_t j = i;
+      while(j < ranges.size() && (ranges[j].min <= max || ranges[j].min - 1 <= max))
+      {
+         if(ranges[j].min < min) min = ranges[j].min;
+         if(ranges[j].max > max) max = ranges[j].max;
+         ++j;
+      }
+
+      ranges.erase(ranges.begin() + i, ranges.begin() + j);
+      ranges.insert(ranges.begin() + i, { min, max });
+      updateAscii();
+   }
+
+   void CharClass::addClass(const CharClass& char_class)
+   {
+      for(auto& range : char_class.ranges)
+      {
+         addRange(range.min, range.max);
+      }
+   }
+
+   void CharClass::intersectClass(const CharClass& char_class)
+   {
+      vector<Range> result;
+
+      uint32_t i = 0;
+      uint32_t j = 0;
+      while(i < ranges.size() && j < char_class.ranges.size())
+      {
+         const Range& a = ranges[i];
+         const Range& b = char_class.ranges[j];
+
+         uint32_t min = a.min > b.min ? a.min : b.min;
+         uint32_t max = a.max < b.max ? a.max : b.max;
+         if(min <= max)
+         {
+            result.push_back({ min, max });
+         }
+
+         if(a.max < b.max) ++i;
+         else ++j;
+      }
+
+      ranges = move(result);
+      updateAscii();
+   }
+
+   void CharClass::complement(uint32_t max_code)
+   {
+      vector<Range> result;
+
+      uint64_t next = 0;
+      for(auto& range : ranges)
+      {
+         if(range.min > max_code)
+         {
+            break;
+         }
+         if(range.min > next)
+         {
+            result.push_back({ uint32_t(next), range.min - 1 });
+         }
+         if(range.max >= max_code)
+         {
+            next = uint64_t(max_code) + 1;
+            break;
+         }
+         next = range.max + 1;
+      }
+      if(next <= max_code)
+      {
+         result.push_back({ uint32_t(next), max_code });
+      }
+
+      ranges = move(result);
+      updateAscii();
+   }
+
+   bool CharClass::contains(uint32_t char_code) const
+   {
+      if(char_code < 128)
+      {
+         return ascii[char_code / 64] & (uint64_t(1) << (char_code % 64));
+      }
+
+      const Range* range = ranges.data();
+      uint32_t count = ranges.size();
+
+      /*
+         Con pocos rangos se prueban todos sin saltos, lo que el compilador
+         puede vectorizar.
+      */
+      if(count <= SMALL_COUNT)
+      {
+         bool found = false;
+         for(uint32_t i = 0; i < count; ++i)
+         {
+            found |= char_code - range[i].min <= range[i].max - range[i].min;
+         }
+         return found;
+      }
+
+      /*
+         Búsqueda binaria sin saltos: se queda con el último rango que
+         empieza antes del código, eligiendo la mitad con una selección
+         condicional.
+      */
+      while(count > 1)
+      {
+         uint32_t half = count / 2;
+         range = range[half].min <= char_code ? range + half : range;
+         count -= half;
+      }
+
+      return char_code - range->min <= range->max - range->min;
+   }
+
+   bool CharClass::empty() const
+   {
+      return ranges.size() == 0;
+   }
+
+   const vector<CharClass::Range>& CharClass::getRanges() const
+   {
+      return ranges;
+   }
+
+   bool CharClass::operator==(const CharClass& char_class) const
+   {
+      if(ranges.size() != char_class.ranges.size())
+      {
+         return false;
+      }
+
+      for(uint32_t i = 0; i < ranges.size(); ++i)
+      {
+         if(ranges[i].min != char_class.ranges[i].min || ranges[i].max != char_class.ranges[i].max)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   void CharClass::updateAscii()
+   {
+      ascii[0] = 0;
+      ascii[1] = 0;
+
+      for(auto& range : ranges)
+      {
+         for(uint32_t c = range.min; c <= range.max && c < 128; ++c)
+         {
+            ascii[c / 64] |= uint64_t(1) << (c % 64);
+         }
+      }
+   }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace dnc
+{
+   class CharClass
+   {
+   public:
+      struct Range
+      {
+         uint32_t min;
+         uint32_t max;
+      };
+
+      CharClass();
+      CharClass(uint32_t min, uint32_t max);
+
+      void addRange(uint32_t min, uint32_t max);
+      void addClass(const CharClass& char_class);
+      /*
+         Dejan solo los códigos que también están en char_class, o los que
+         no están en la clase dentro del rango [0, max_code].
+      */
+      void intersectClass(const CharClass& char_class);
+      void complement(uint32_t max_code);
+
+      bool contains(uint32_t char_code) const;
+      bool empty() const;
+
+      const std::vector<Range>& getRanges() const;
+
+      bool operator==(const CharClass& char_class) const;
+
+   private:
+      static const uint32_t SMALL_COUNT;
+
+      std::vector<Range> ranges;
+      uint64_t ascii[2];
+
+      void updateAscii();
+   };
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "CommandArena.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   const uint64_t CommandArena::FIRST_BLOCK_SIZE = 1 << 10;
+   const uint64_t CommandArena::MAX_BLOCK_SIZE = 64 << 10;
+
+   CommandArena::CommandArena() :
+      current(nullptr),
+      block_end(nullptr),
+      next_block_size(FIRST_BLOCK_SIZE),
+      size(0),
+      destructors(nullptr)
+   {}
+
+   CommandArena::~CommandArena()
+   {
+      /*
+         Los objetos no se destruyen entre sí, así que alcanza con recorrer
+         la lista una vez.
+      */
+      for(Destructor* destructor = destructors; destructor != nullptr; destructor = destructor->next)
+      {
+         destructor->destroy(destructor->object);
+      }
+
+      for(auto block : blocks)
+      {
+         delete[] block;
+      }
+   }
+
+   uint64_t CommandArena::getSize() const
+   {
+      return size;
+   }
+
+   uint32_t CommandArena::getBlockCount() const
+   {
+      return blocks.size();
+   }
+
+   CommandArena::Mark CommandArena::mark() const
+   {
+      return { uint32_t(blocks.size()), current, block_end, size, destructors };
+   }
+
+   void CommandArena::rewind(const Mark& mark)
+   {
+      Destructor* mark_destructors = static_cast<Destructor*>(mark.destructors);
+      while(destructors != mark_destructors)
+      {
+         destructors->destroy(destructors->object);
+         destructors = destructors->next;
+      }
+
+      while(blocks.size() > mark.block_count)
+      {
+         delete[] blocks.back();
+         blocks.pop_back();
+      }
+
+      current = mark.current;
+      block_end = mark.block_end;
+      size = mark.size;
+   }
+
+   void* CommandArena::allocate(uint64_t bytes, uint64_t alignment)
+   {
+      uintptr_t address = (reinterpret_cast<uintptr_t>(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+      if(current == nullptr || address + bytes > reinterpret_cast<uintptr_t>(block_end))
+      {
+         addBlock(bytes + alignment);
+         address = (reinterpret_cast<uintptr_t>(current) + alignment - 1) & ~uintptr_t(alignment - 1);
+      }
+
+      size += address + bytes - reinterpret_cast<uintptr_t>(current);
+      current = reinterpret_cast<char*>(address + bytes);
+      return reinterpret_cast<void*>(address);
+   }
+
+   void CommandArena::addBlock(uint64_t bytes)
+   {
+      uint64_t block_size = next_block_size;
+      while(block_size < bytes)
+      {
+         block_size *= 2;
+      }
+
+      if(next_block_size < MAX_BLOCK_SIZE)
+      {
+         next_block_size *= 2;
+      }
+
+      current = new char[block_size];
+      block_end = current + block_size;
+      blocks.push_back(current);
+   }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+namespace dnc
+{
+   /*
+      Memoria de los comandos de una expresión. Los objetos y los arreglos
+      se ubican uno detrás de otro, en el orden en que se crean, en bloques
+      que crecen al doble. No se liberan por separado: el arena los
+      destruye todos juntos cuando se destruye.
+   */
+   class CommandArena
+   {
+   public:
+      /*
+         Arreglo de solo lectura ubicado en un arena.
+      */
+      template<typename Type>
+      class Array
+      {
+      public:
+         Array();
+
+         const Type* begin() const;
+         const Type* end() const;
+         uint32_t size() const;
+         bool empty() const;
+
+         const Type& operator[](uint32_t index) const;
+
+      private:
+         friend class CommandArena;
+
+         const Type* data;
+         uint32_t count;
+      };
+
+      CommandArena();
+      ~CommandArena();
+
+      template<typename Type, typename... Args>
+      Type* create(Args&&... args);
+
+      /*
+         Copia los valores en un arreglo del arena. Deben poder copiarse
+         byte a byte.
+      */
+      template<typename Type>
+      Array<Type> createArray(const std::vector<Type>& values);
+
+      /*
+         Bytes usados por los objetos, sin contar lo que queda libre en los
+         bloques.
+      */
+      uint64_t getSize() const;
+      uint32_t getBlockCount() const;
+
+      /*
+         Estado del arena en un momento dado. rewind() destruye y libera lo
+         creado después de la marca, que no debe seguir en uso.
+      */
+      struct Mark
+      {
+         uint32_t block_count;
+         char* current;
+         char* block_end;
+         uint64_t size;
+         void* destructors;
+      };
+
+      Mark mark() const;
+      void rewind(const Mark& mark);
+
+   private:
+      /*
+         Se ubica antes de cada objeto que necesita su destructor.
+      */
+      struct Destructor
+      {
+         void (*destroy)(void* object);
+         void* object;
+         Destructor* next;
+      };
+
+      static const uint64_t FIRST_BLOCK_SIZE;
+      static const uint64_t MAX_BLOCK_SIZE;
+
+      std::vector<char*> blocks;
+      char* current;
+      char* block_end;
+      uint64_t next_block_size;
+      uint64_t size;
+      Destructor* destructors;
+
+      void* allocate(uint64_t bytes, uint64_t alignment);
+      void addBlock(uint64_t bytes);
+
+      template<typename Type>
+      static void destroy(void* object);
+   };
+
+   template<typename Type>
+   CommandArena::Array<Type>::Array() :
+      data(nullptr),
+      count(0)
+   {}
+
+   template<typename Type>
+   const Type* CommandArena::Array<Type>::begin() const
+   {
+      return data;
+   }
+
+   template<typename Type>
+   const Type* CommandArena::Array<Type>::end() const
+   {
+      return data + count;
+   }
+
+   template<typename Type>
+   uint32_t CommandArena::Array<Type>::size() const
+   {
+      return count;
+   }
+
+   template<typename Type>
+   bool CommandArena::Array<Type>::empty() const
+   {
+      return count == 0;
+   }
+
+   template<typename Type>
+   const Type& CommandArena::Array<Type>::operator[](uint32_t index) const
+   {
+      return data[index];
+   }
+
+   template<typename Type, typename... Args>
+   Type* CommandArena::create(Args&&... args)
+   {
+      Destructor* destructor = nullptr;
+      if(!std::is_trivially_destructible<Type>::value)
+      {
+         destructor = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+      }
+
+      Type* object = new(allocate(sizeof(Type), alignof(Type))) Type(std::forward<Args>(args)...);
+
+      if(destructor != nullptr)
+      {
+         destructor->destroy = &destroy<Type>;
+         destructor->object = object;
+         destructor->next = destructors;
+         destructors = destructor;
+      }
+
+      return object;
+   }
+
+   template<typename Type>
+   CommandArena::Array<Type> CommandArena::createArray(const std::vector<Type>& values)
+   {
+      static_assert(std::is_trivially_copyable<Type>::value, "Los arreglos del arena se copian byte a byte");
+
+      Array<Type> array;
+      if(values.empty())
+      {
+         return array;
+      }
+
+      Type* data = static_cast<Type*>(allocate(values.size() * sizeof(Type), alignof(Type)));
+      for(uint32_t i = 0; i < values.size(); ++i)
+      {
+         data[i] = values[i];
+      }
+
+      array.data = data;
+      array.count = values.size();
+      return array;
+   }
+
+   template<typename Type>
+   void CommandArena::destroy(void* object)
+   {
+      static_cast<Type*>(object)->~Type();
+   }
+}
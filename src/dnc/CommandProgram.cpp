@@ -0,0 +1,351 @@
+#include "CommandProgram.hpp"
+
+#include "StringUtils.hpp"
+#include "UTF8Analyzer.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   namespace
+   {
+      bool isBlank(uint8_t c)
+      {
+         return c <= 32 || c == 127;
+      }
+
+      bool isDigit(uint8_t c)
+      {
+         return c >= '0' && c <= '9';
+      }
+   }
+
+   CommandProgram::CommandProgram()
+   {}
+
+   CommandProgram::~CommandProgram()
+   {}
+
+   uint32_t CommandProgram::size() const
+   {
+      return instructions.size();
+   }
+
+   uint32_t CommandProgram::addInstruction(Opcode opcode, uint32_t arg0, uint32_t arg1)
+   {
+      Instruction instruction;
+      instruction.opcode = opcode;
+      instruction.arg0 = arg0;
+      instruction.arg1 = arg1;
+      instruction.command = nullptr;
+
+      instructions.push_back(instruction);
+      return instructions.size() - 1;
+   }
+
+   uint32_t CommandProgram::addString(const string& value)
+   {
+      strings.push_back(value);
+      return addInstruction(STRING, strings.size() - 1);
+   }
+
+   uint32_t CommandProgram::addClass(const RegularMatcher::Atom& atom)
+   {
+      classes.push_back(atom);
+      return addInstruction(CLASS, classes.size() - 1);
+   }
+
+   uint32_t CommandProgram::addBytes(const ByteSearch& bytes)
+   {
+      byte_sets.push_back(bytes);
+      return addInstruction(BYTES, byte_sets.size() - 1);
+   }
+
+   uint32_t CommandProgram::addCommand(const LanguageExpression::Command* command)
+   {
+      uint32_t instruction = addInstruction(COMMAND);
+      instructions[instruction].command = command;
+      return instruction;
+   }
+
+   uint32_t CommandProgram::addCall(const LanguageExpression* expression)
+   {
+      uint32_t instruction = addInstruction(CALL);
+      instructions[instruction].expression = expression;
+      return instruction;
+   }
+
+   void CommandProgram::setTarget(uint32_t instruction, uint32_t target)
+   {
+      instructions[instruction].arg0 = target;
+   }
+
+   bool CommandProgram::run(string_view text, uint64_t& pos, uint64_t last_pos, uint32_t entry) const
+   {
+      /*
+         CALL puede volver a entrar aquí (incluso en este mismo programa), por
+         lo que las pilas son del hilo y cada ejecución solo usa la parte que
+         está por encima de donde empezó.
+      */
+      thread_local vector<Frame> frames;
+      thread_local vector<Counter> counters;
+
+      const uint32_t frame_base = frames.size();
+      const uint32_t counter_base = counters.size();
+
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+      const uint64_t text_size = text.size();
+      const uint64_t end = last_pos < text_size ? last_pos : text_size;
+
+      uint64_t current_pos = pos;
+      uint32_t pc = entry;
+
+      while(true)
+      {
+         const Instruction& instruction = instructions[pc];
+         bool ok = true;
+
+         switch(instruction.opcode)
+         {
+         case GUARD:
+            ok = current_pos < end;
+            if(!ok) UTF8Analyzer::setEndReached();
+            ++pc;
+            break;
+
+         case STRING:
+         {
+            const string& value = strings[instruction.arg0];
+            if(current_pos >= end || current_pos + value.size() > end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+            ok = text.compare(current_pos, value.size(), value) == 0;
+            if(ok) current_pos += value.size();
+            ++pc;
+            break;
+         }
+
+         case CLASS:
+            if(current_pos >= end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+            ok = classes[instruction.arg0].checkChar(text, current_pos);
+            ++pc;
+            break;
+
+         case BYTES:
+            if(current_pos >= end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+            ok = byte_sets[instruction.arg0].contains(data[current_pos]);
+            ++pc;
+            break;
+
+         case NUMBER:
+         {
+            if(current_pos >= end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+            if(!isDigit(data[current_pos]))
+            {
+               ok = false;
+               break;
+            }
+
+            uint64_t i = current_pos + 1;
+            bool added_point = false;
+            while(i < text_size && (isDigit(data[i]) || (data[i] == '.' && !added_point)))
+            {
+               if(data[i] == '.') added_point = true;
+               ++i;
+            }
+            if(i == text_size) UTF8Analyzer::setEndReached();
+
+            current_pos = i;
+            ++pc;
+            break;
+         }
+
+         case BLANK:
+         case OPTBLANK:
+         {
+            if(current_pos >= end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+
+            uint64_t i = current_pos;
+            while(i < text_size && isBlank(data[i]))
+            {
+               ++i;
+            }
+            if(i == text_size) UTF8Analyzer::setEndReached();
+
+            ok = instruction.opcode == OPTBLANK || i > current_pos;
+            current_pos = i;
+            ++pc;
+            break;
+         }
+
+         case COMMAND:
+            ok = instruction.command->check(text, current_pos, last_pos);
+            ++pc;
+            break;
+
+         case CALL:
+            if(current_pos >= end)
+            {
+               UTF8Analyzer::setEndReached();
+               ok = false;
+               break;
+            }
+            ok = ParseMemo::check(instruction.expression, text, current_pos, last_pos);
+            ++pc;
+            break;
+
+         case CATCH:
+            frames.push_back({ instruction.arg0, current_pos, uint32_t(counters.size()) });
+            ++pc;
+            break;
+
+         case COMMIT:
+            frames.pop_back();
+            pc = instruction.arg0;
+            break;
+
+         case JUMP:
+            pc = instruction.arg0;
+            break;
+
+         case COUNTER_PUSH:
+            counters.push_back({ 0, false, current_pos });
+            ++pc;
+            break;
+
+         case COUNTER_INC:
+            counters.back().count += 1;
+            ++pc;
+            break;
+
+         case COUNTER_MARK:
+            counters.back().mark = true;
+            ++pc;
+            break;
+
+         case COUNTER_TEST:
+            ok = !counters.back().mark;
+            ++pc;
+            break;
+
+         case COUNTER_POP:
+         {
+            uint32_t count = counters.back().count;
+            counters.pop_back();
+            ok = count >= instruction.arg0 && count <= instruction.arg1;
+            ++pc;
+            break;
+         }
+
+         case PROGRESS:
+            /*
+               Una repetición que no avanzó se repetiría para siempre, así
+               que termina la repetición.
+            */
+            if(current_pos == counters.back().pos)
+            {
+               pc = instruction.arg0;
+               break;
+            }
+            counters.back().pos = current_pos;
+            ++pc;
+            break;
+
+         case MATCH:
+            frames.resize(frame_base);
+            counters.resize(counter_base);
+            pos = current_pos;
+            return true;
+         }
+
+         if(!ok)
+         {
+            if(frames.size() == frame_base)
+            {
+               counters.resize(counter_base);
+               return false;
+            }
+
+            Frame frame = frames.back();
+            frames.pop_back();
+
+            counters.resize(frame.counter_count);
+            current_pos = frame.pos;
+            pc = frame.target;
+         }
+      }
+   }
+
+   string CommandProgram::toString() const
+   {
+      static const char* OPCODE_NAMES[] = {
+         "GUARD", "STRING", "CLASS", "BYTES", "NUMBER", "BLANK", "OPTBLANK", "COMMAND", "CALL",
+         "CATCH", "COMMIT", "JUMP", "COUNTER_PUSH", "COUNTER_INC", "COUNTER_MARK",
+         "COUNTER_TEST", "COUNTER_POP", "PROGRESS", "MATCH"
+      };
+
+      string result;
+      for(uint32_t i = 0; i < instructions.size(); ++i)
+      {
+         auto& instruction = instructions[i];
+         result += dnc::toString(i) + ": " + OPCODE_NAMES[instruction.opcode];
+
+         switch(instruction.opcode)
+         {
+         case STRING:
+            result += " \"" + strings[instruction.arg0] + "\"";
+            break;
+
+         case CLASS:
+         case BYTES:
+            result += " " + dnc::toString(instruction.arg0);
+            break;
+
+         case COMMAND:
+            result += " " + instruction.command->toString();
+            break;
+
+         case CATCH:
+         case COMMIT:
+         case JUMP:
+         case PROGRESS:
+            result += " " + dnc::toString(instruction.arg0);
+            break;
+
+         case COUNTER_POP:
+            result += " " + dnc::toString(instruction.arg0) + "," + dnc::toString(instruction.arg1);
+            break;
+
+         default:
+            break;
+         }
+
+         result += "\n";
+      }
+
+      return result;
+   }
+}
\ No newline at end of file
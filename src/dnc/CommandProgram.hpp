@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "RegularMatcher.hpp"
+#include "ByteSearch.hpp"
+
+namespace dnc
+{
+   /*
+      Programa lineal equivalente a una secuencia de comandos. Se ejecuta con
+      un bucle de instrucciones y una pila explícita de puntos de retroceso,
+      en lugar de recorrer el árbol de comandos.
+   */
+   class CommandProgram
+   {
+   public:
+      enum Opcode
+      {
+         GUARD,
+         STRING,
+         CLASS,
+         BYTES,
+         NUMBER,
+         BLANK,
+         OPTBLANK,
+         COMMAND,
+         CALL,
+         CATCH,
+         COMMIT,
+         JUMP,
+         COUNTER_PUSH,
+         COUNTER_INC,
+         COUNTER_MARK,
+         COUNTER_TEST,
+         COUNTER_POP,
+         PROGRESS,
+         MATCH
+      };
+
+      struct Instruction
+      {
+         Opcode opcode;
+         uint32_t arg0;
+         uint32_t arg1;
+         union
+         {
+            const LanguageExpression::Command* command;
+            const LanguageExpression* expression;
+         };
+      };
+
+      CommandProgram();
+      ~CommandProgram();
+
+      uint32_t size() const;
+
+      uint32_t addInstruction(Opcode opcode, uint32_t arg0 = 0, uint32_t arg1 = 0);
+      uint32_t addString(const std::string& value);
+      uint32_t addClass(const RegularMatcher::Atom& atom);
+      /*
+         BYTES no avanza: falla si el byte siguiente no está en el conjunto.
+      */
+      uint32_t addBytes(const ByteSearch& bytes);
+      uint32_t addCommand(const LanguageExpression::Command* command);
+      uint32_t addCall(const LanguageExpression* expression);
+
+      void setTarget(uint32_t instruction, uint32_t target);
+
+      bool run(std::string_view text, uint64_t& pos, uint64_t last_pos, uint32_t entry = 0) const;
+
+      std::string toString() const;
+
+   private:
+      struct Frame
+      {
+         uint32_t target;
+         uint64_t pos;
+         uint32_t counter_count;
+      };
+
+      /*
+         pos es donde empezó la repetición actual.
+      */
+      struct Counter
+      {
+         uint32_t count;
+         bool mark;
+         uint64_t pos;
+      };
+
+      std::vector<Instruction> instructions;
+      std::vector<std::string> strings;
+      std::vector<RegularMatcher::Atom> classes;
+      std::vector<ByteSearch> byte_sets;
+   };
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "CommandRegistry.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   CommandRegistry::CommandRegistry() :
+      reuse_count(0),
+      saved_size(0)
+   {}
+
+   CommandRegistry::~CommandRegistry()
+   {}
+
+   uint32_t CommandRegistry::getCommandCount() const
+   {
+      lock_guard<mutex> lock(registry_mutex);
+      return commands.size();
+   }
+
+   uint64_t CommandRegistry::getReuseCount() const
+   {
+      lock_guard<mutex> lock(registry_mutex);
+      return reuse_count;
+   }
+
+   uint64_t CommandRegistry::getSize() const
+   {
+      lock_guard<mutex> lock(registry_mutex);
+      return arena.getSize();
+   }
+
+   uint64_t CommandRegistry::getSavedSize() const
+   {
+      lock_guard<mutex> lock(registry_mutex);
+      return saved_size;
+   }
+
+   bool CommandRegistry::getCommand(const string& key, LanguageExpression::Command*& command, const function<bool(CommandArena&)>& create)
+   {
+      lock_guard<mutex> lock(registry_mutex);
+
+      auto found = commands.find(key);
+      if(found != commands.end())
+      {
+         command = found->second.command;
+         reuse_count += 1;
+         saved_size += found->second.size;
+         return true;
+      }
+
+      uint64_t begin_size = arena.getSize();
+      CommandArena::Mark begin = arena.mark();
+      if(!create(arena))
+      {
+         /*
+            Lo que se creó antes de fallar no queda en el registro, que
+            puede durar mientras se rechazan muchas expresiones.
+         */
+         arena.rewind(begin);
+         return false;
+      }
+
+      /*
+         Los comandos internos ya están guardados, así que el tamaño es el
+         del comando y sus listas. El conjunto inicial se calcula antes de
+         que otra expresión pueda tomarlo.
+      */
+      command->createFirstSet();
+      command->shared = true;
+
+      commands[key] = { command, arena.getSize() - begin_size };
+      return true;
+   }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+
+#include "LanguageExpression.hpp"
+#include "CommandArena.hpp"
+
+namespace dnc
+{
+   /*
+      Comandos compartidos por las expresiones creadas con el mismo
+      registro. Un comando con el mismo nombre, los mismos argumentos y los
+      mismos comandos internos que otro ya guardado no se vuelve a crear:
+      como los internos se buscan primero, las partes iguales de dos
+      expresiones terminan siendo los mismos objetos. Los comandos con
+      EXP(), y los que los contienen, no se comparten.
+
+      Los comandos guardados no cambian y el registro puede usarse desde
+      varios hilos. Debe existir mientras existan las expresiones creadas
+      con él.
+   */
+   class CommandRegistry
+   {
+   public:
+      CommandRegistry();
+      CommandRegistry(const CommandRegistry&) = delete;
+      ~CommandRegistry();
+
+      CommandRegistry& operator=(const CommandRegistry&) = delete;
+
+      /*
+         Comandos distintos guardados, y veces que una expresión tomó uno
+         ya guardado en lugar de crearlo.
+      */
+      uint32_t getCommandCount() const;
+      uint64_t getReuseCount() const;
+
+      /*
+         Bytes que ocupan los comandos guardados, y bytes que habrían
+         ocupado los que se tomaron ya guardados.
+      */
+      uint64_t getSize() const;
+      uint64_t getSavedSize() const;
+
+   private:
+      friend class LanguageExpression;
+
+      struct Entry
+      {
+         LanguageExpression::Command* command;
+         uint64_t size;
+      };
+
+      mutable std::mutex registry_mutex;
+      CommandArena arena;
+      std::unordered_map<std::string, Entry> commands;
+      uint64_t reuse_count;
+      uint64_t saved_size;
+
+      /*
+         Devuelve el comando guardado con la clave, o lo crea con create en
+         el arena del registro y calcula su conjunto inicial antes de
+         guardarlo.
+      */
+      bool getCommand(const std::string& key, LanguageExpression::Command*& command, const std::function<bool(CommandArena&)>& create);
+   };
+}
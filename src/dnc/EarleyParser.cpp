@@ -0,0 +1,371 @@
+#include "EarleyParser.hpp"
+
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+
+using namespace std;
+
+namespace dnc
+{
+   namespace
+   {
+      /*
+         Producción, posición del punto y posición del texto donde empezó.
+         node es el nodo del bosque con los símbolos ya analizados.
+      */
+      struct Item
+      {
+         uint32_t production;
+         uint32_t dot;
+         uint64_t origin;
+         uint32_t node;
+      };
+
+      struct ItemKey
+      {
+         uint32_t production;
+         uint32_t dot;
+         uint64_t origin;
+
+         bool operator==(const ItemKey& other) const
+         {
+            return production == other.production && dot == other.dot && origin == other.origin;
+         }
+      };
+
+      struct ItemKeyHash
+      {
+         size_t operator()(const ItemKey& key) const
+         {
+            return key.origin * 0x9E3779B97F4A7C15ull ^ (uint64_t(key.production) << 20) ^ key.dot;
+         }
+      };
+
+      const uint64_t UNTRIED = uint64_t(-1);
+      const uint64_t FAILED = uint64_t(-2);
+      const uint64_t NO_LEO = uint64_t(-1);
+      const uint64_t UNKNOWN_LEO = uint64_t(-2);
+      const uint32_t NO_COLUMN = uint32_t(-1);
+
+      /*
+         Ítems de una posición del texto. waiting son los que esperan la
+         gramática y completed, las posiciones desde las que ya se la
+         completó aquí. keys, completed y token_ends solo se usan mientras
+         se procesa la posición.
+
+         leo_top es la posición del ítem más alto de la cadena determinista
+         (Leo) que empieza aquí: si el único ítem que espera la gramática la
+         tiene como último símbolo, completarla aquí solo puede completar
+         ese ítem, y así sucesivamente.
+      */
+      struct Column
+      {
+         vector<Item> items;
+         unordered_set<ItemKey, ItemKeyHash> keys;
+         vector<uint32_t> waiting;
+         unordered_set<uint64_t> completed;
+         vector<uint64_t> token_ends;
+         bool predicted = false;
+         uint64_t leo_top = UNKNOWN_LEO;
+      };
+   }
+
+   EarleyParser::EarleyParser()
+   {}
+
+   EarleyParser::~EarleyParser()
+   {}
+
+   bool EarleyParser::create(const LanguageExpression* grammar, const vector<const LanguageExpression*>& rules)
+   {
+      return grammar_productions.create(grammar, rules);
+   }
+
+   void EarleyParser::clear()
+   {
+      grammar_productions.clear();
+   }
+
+   bool EarleyParser::parse(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest, ParseForest& forest) const
+   {
+      forest.clear();
+      forest.productions = &grammar_productions;
+
+      auto& productions = grammar_productions.getProductions();
+      const uint32_t token_count = grammar_productions.getTokens().size();
+
+      /*
+         Los terminales avanzan, así que cada posición se procesa una sola
+         vez y en orden: nada de lo que se agrega después vuelve a ella.
+         Las columnas se buscan por posición y solo se crean las que tienen
+         ítems.
+      */
+      const uint64_t end = last_pos < text.size() ? last_pos : text.size();
+      vector<uint32_t> column_ids(end - pos + 1, NO_COLUMN);
+      deque<Column> columns;
+
+      auto getColumn = [&](uint64_t column_pos) -> Column& {
+         uint32_t& id = column_ids[column_pos - pos];
+         if(id == NO_COLUMN)
+         {
+            id = columns.size();
+            columns.emplace_back();
+         }
+         return columns[id];
+      };
+
+      auto addItem = [&](Column& column, const Item& item) {
+         if(column.keys.insert({ item.production, item.dot, item.origin }).second)
+         {
+            column.items.push_back(item);
+         }
+      };
+
+      auto predict = [&](Column& column, uint64_t column_pos) {
+         if(!column.predicted)
+         {
+            column.predicted = true;
+            for(uint32_t p = 0; p < productions.size(); ++p)
+            {
+               addItem(column, { p, 0, column_pos, ParseForest::NO_NODE });
+            }
+         }
+      };
+
+      auto advance = [&](const Item& item, uint32_t child, uint64_t end) {
+         uint32_t dot = item.dot + 1;
+         uint32_t node = child;
+
+         /*
+            Con un solo símbolo analizado, el nodo es el propio símbolo.
+         */
+         if(dot == productions[item.production].symbols.size())
+         {
+            node = forest.addNode(ParseForest::GRAMMAR, 0, 0, item.origin, end);
+            forest.addAlternative(node, { item.production, item.node, child });
+         }
+         else if(dot > 1)
+         {
+            node = forest.addNode(ParseForest::PARTIAL, item.production, dot, item.origin, end);
+            forest.addAlternative(node, { item.production, item.node, child });
+         }
+
+         addItem(getColumn(end), { item.production, dot, item.origin, node });
+      };
+
+      /*
+         El ítem de una posición ya procesada que espera la gramática como
+         último símbolo, si es el único que la espera.
+      */
+      auto getLeoItem = [&](uint64_t column_pos) -> const Item* {
+         Column& column = getColumn(column_pos);
+         if(column.waiting.size() != 1)
+         {
+            return nullptr;
+         }
+
+         const Item& item = column.items[column.waiting[0]];
+         return item.dot + 1 == productions[item.production].symbols.size() ? &item : nullptr;
+      };
+
+      /*
+         Las cadenas pueden ser tan largas como el texto, así que se
+         recorren sin recursión y se guarda el resultado de cada posición.
+      */
+      vector<uint64_t> leo_path;
+      auto getLeoTop = [&](uint64_t column_pos) -> uint64_t {
+         uint64_t top = NO_LEO;
+         while(true)
+         {
+            Column& column = getColumn(column_pos);
+            if(column.leo_top != UNKNOWN_LEO)
+            {
+               top = column.leo_top;
+               break;
+            }
+
+            const Item* item = getLeoItem(column_pos);
+            if(item == nullptr)
+            {
+               column.leo_top = NO_LEO;
+               break;
+            }
+
+            leo_path.push_back(column_pos);
+            column_pos = item->origin;
+         }
+
+         while(!leo_path.empty())
+         {
+            Column& column = getColumn(leo_path.back());
+            column.leo_top = top != NO_LEO ? top : leo_path.back();
+            top = column.leo_top;
+            leo_path.pop_back();
+         }
+
+         return top;
+      };
+
+      /*
+         Los nodos que se completaron con una cadena de Leo, con las
+         posiciones donde empezó cada cadena. Sus nodos intermedios se
+         arman al final, solo si el árbol los usa.
+      */
+      unordered_map<uint32_t, vector<uint64_t>> leo_nodes;
+
+      predict(getColumn(pos), pos);
+
+      bool matched = false;
+      uint64_t end_pos = pos;
+
+      for(uint64_t column_pos = pos; column_pos <= end; ++column_pos)
+      {
+         if(column_ids[column_pos - pos] == NO_COLUMN)
+         {
+            continue;
+         }
+
+         Column& column = getColumn(column_pos);
+         column.token_ends.assign(token_count, UNTRIED);
+
+         for(uint32_t k = 0; k < column.items.size(); ++k)
+         {
+            Item item = column.items[k];
+            auto& symbols = productions[item.production].symbols;
+
+            if(item.dot == symbols.size())
+            {
+               if(item.origin == pos)
+               {
+                  matched = true;
+                  end_pos = column_pos;
+               }
+
+               if(column.completed.insert(item.origin).second)
+               {
+                  uint64_t top = getLeoTop(item.origin);
+                  if(top != NO_LEO)
+                  {
+                     const Item& top_item = *getLeoItem(top);
+                     uint32_t node = forest.addNode(ParseForest::GRAMMAR, 0, 0, top_item.origin, column_pos);
+                     leo_nodes[node].push_back(item.origin);
+                     addItem(column, { top_item.production, top_item.dot + 1, top_item.origin, node });
+                     continue;
+                  }
+
+                  uint32_t node = forest.findNode(ParseForest::GRAMMAR, 0, 0, item.origin, column_pos);
+                  Column& origin = getColumn(item.origin);
+                  for(auto waiting : origin.waiting)
+                  {
+                     advance(origin.items[waiting], node, column_pos);
+                  }
+               }
+            }
+            else if(symbols[item.dot] == GrammarProductions::NONTERMINAL)
+            {
+               column.waiting.push_back(k);
+               predict(column, column_pos);
+            }
+            else
+            {
+               uint32_t token = symbols[item.dot];
+               uint64_t& token_end = column.token_ends[token];
+               if(token_end == UNTRIED)
+               {
+                  token_end = column_pos;
+                  if(!grammar_productions.matchToken(token, text, token_end, last_pos))
+                  {
+                     token_end = FAILED;
+                  }
+               }
+
+               if(token_end != FAILED)
+               {
+                  advance(item, forest.addNode(ParseForest::TOKEN, token, 0, column_pos, token_end), token_end);
+               }
+            }
+         }
+
+         column.keys = {};
+         column.completed = {};
+         column.token_ends = {};
+      }
+
+      uint32_t root = ParseForest::NO_NODE;
+      if(ignore_rest)
+      {
+         if(matched)
+         {
+            root = forest.findNode(ParseForest::GRAMMAR, 0, 0, pos, end_pos);
+         }
+      }
+      else root = forest.findNode(ParseForest::GRAMMAR, 0, 0, pos, last_pos);
+
+      if(root == ParseForest::NO_NODE)
+      {
+         return false;
+      }
+
+      /*
+         Cada paso de una cadena de Leo completa la gramática desde el
+         origen del ítem de su posición con la que se completó desde esa
+         posición. Un paso ya armado por otra cadena deja el resto igual.
+      */
+      unordered_set<uint32_t> leo_children;
+      auto buildLeoChain = [&](uint64_t column_pos, uint64_t chain_end) {
+         uint32_t child = forest.findNode(ParseForest::GRAMMAR, 0, 0, column_pos, chain_end);
+         while(leo_children.insert(child).second)
+         {
+            const Item& item = *getLeoItem(column_pos);
+            uint32_t parent = forest.addNode(ParseForest::GRAMMAR, 0, 0, item.origin, chain_end);
+            forest.addAlternative(parent, { item.production, item.node, child });
+
+            if(getColumn(column_pos).leo_top == column_pos)
+            {
+               break;
+            }
+
+            column_pos = item.origin;
+            child = parent;
+         }
+      };
+
+      vector<bool> visited(forest.nodes.size());
+      vector<uint32_t> pending = { root };
+      visited[root] = true;
+
+      while(!pending.empty())
+      {
+         uint32_t node = pending.back();
+         pending.pop_back();
+
+         auto chains = leo_nodes.find(node);
+         if(chains != leo_nodes.end())
+         {
+            for(auto chain_begin : chains->second)
+            {
+               buildLeoChain(chain_begin, forest.nodes[node].end);
+            }
+            leo_nodes.erase(chains);
+            visited.resize(forest.nodes.size());
+         }
+
+         for(auto& alternative : forest.nodes[node].alternatives)
+         {
+            for(auto child : { alternative.left, alternative.right })
+            {
+               if(child != ParseForest::NO_NODE && !visited[child])
+               {
+                  visited[child] = true;
+                  pending.push_back(child);
+               }
+            }
+         }
+      }
+
+      forest.root = root;
+      pos = forest.nodes[root].end;
+      return true;
+   }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "GrammarProductions.hpp"
+#include "ParseForest.hpp"
+
+namespace dnc
+{
+   /*
+      Análisis de Earley de las producciones de una gramática (ver
+      GrammarProductions). Acepta cualquier gramática, incluso ambigua o
+      recursiva a izquierda, en tiempo a lo sumo cúbico, y arma un
+      ParseForest con todos los análisis. Las reglas recursivas a derecha
+      se completan con las cadenas de Leo, así que una gramática sin
+      ambigüedades, por ejemplo una lista recursiva a derecha, se analiza
+      en tiempo y memoria lineales.
+   */
+   class EarleyParser
+   {
+   public:
+      EarleyParser();
+      ~EarleyParser();
+
+      /*
+         Falla si las reglas no forman producciones.
+      */
+      bool create(const LanguageExpression* grammar, const std::vector<const LanguageExpression*>& rules);
+      void clear();
+
+      /*
+         El análisis tiene que llegar a last_pos, salvo que ignore_rest sea
+         true; en ese caso se usa el más largo. El bosque es válido mientras
+         exista este objeto.
+      */
+      bool parse(std::string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest, ParseForest& forest) const;
+
+   private:
+      GrammarProductions grammar_productions;
+   };
+}
@@ -1,5 +1,6 @@
 #include "Grammar.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 #include "UTF8Analyzer.hpp"
@@ -8,15 +9,31 @@ using namespace std;
 
 namespace dnc
 {
+   namespace
+   {
+      bool isBlank(uint8_t c)
+      {
+         return c <= 32 || c == 127;
+      }
+   }
+
    Grammar::Grammar() :
       HERO_EXPRESSION("NUMT()"),
-      terminal_ref()
-   {}
+      parse_table(nullptr),
+      predictive_table(nullptr),
+      earley_parser(nullptr)
+   {
+      self_set.refs.push_back(this);
+      createRuleTables();
+   }
 
    Grammar::Grammar(const vector<const LanguageExpression*>& expressions) :
       HERO_EXPRESSION("NUMT()"),
-      terminal_ref()
+      parse_table(nullptr),
+      predictive_table(nullptr),
+      earley_parser(nullptr)
    {
+      self_set.refs.push_back(this);
       setExpressions(expressions);
    }
 
@@ -25,139 +42,688 @@ namespace dnc
       clear();
    }
 
-   LanguageExpression::InitExpressionChar Grammar::getInitExpressionChar() const
+   const LanguageExpression::FirstSet& Grammar::getFirstSet() const
    {
-      return { ExpressionChar(this) };
+      return self_set;
    }
 
    void Grammar::setExpressions(const vector<const LanguageExpression*>& expressions)
    {
       clear();
 
-      for(uint32_t i = 0; i < expressions.size(); ++i)
+      for(auto expression : expressions)
       {
-         auto init_char_vec = expressions[i]->getInitExpressionChar();
-         for(auto& init_char : init_char_vec)
+         auto& init_set = expression->getFirstSet();
+         rules.push_back(expression);
+
+         bool nonterminal = false;
+         for(auto ref : init_set.refs)
          {
-            switch(init_char.type)
+            if(ref != this)
             {
-            case ExpressionChar::TERMINAL:
-            {
-               auto& value = init_char.value;
-               int char_count = 0;
-               uint32_t pos = 0;
-               while(UTF8Analyzer::countNextChar(value, char_count, pos))
-               {
-                  string substr = value.substr(pos, char_count);
-                  terminal_ref[substr].insert(expressions[i]);
-                  pos += char_count;
-               }
-               break;
+               clear();
+               return;
             }
+            nonterminal = true;
+         }
 
-            case ExpressionChar::NONTERMINAL:
-               if(init_char.ref != this)
-               {
-                  clear();
-                  return;
-               }
-               nonterminal_ref.insert(expressions[i]);
-               break;
+         if(nonterminal)
+         {
+            nonterminal_rules.push_back(expression);
+         }
 
-            case ExpressionChar::ANY_TERMINAL:
-               any_terminal_ref.insert(expressions[i]);
-               break;
-            }
+         if(init_set.any || init_set.nullable || !init_set.chars.empty() || !init_set.value_chars.empty())
+         {
+            terminal_rules.push_back(expression);
          }
       }
+
+      createRuleTables();
+   }
+
+   void Grammar::addOperator(const LanguageExpression* symbol, OperatorType type, uint32_t precedence, const FactoryFunction& func)
+   {
+      operators.push_back({ symbol, type, precedence, func });
+   }
+
+   void Grammar::clearOperators()
+   {
+      operators.clear();
+   }
+
+   const vector<Grammar::Conflict>& Grammar::getConflicts() const
+   {
+      return conflicts;
+   }
+
+   bool Grammar::hasRuleConflicts() const
+   {
+      return !conflicts.empty();
+   }
+
+   void Grammar::setRulePrecedence(const LanguageExpression* rule, uint32_t precedence, bool right_associative)
+   {
+      for(auto& rule_precedence : precedences)
+      {
+         if(rule_precedence.rule == rule)
+         {
+            rule_precedence.precedence = precedence;
+            rule_precedence.right_associative = right_associative;
+            return;
+         }
+      }
+
+      precedences.push_back({ rule, precedence, right_associative });
+   }
+
+   bool Grammar::createParseTable()
+   {
+      deleteParseTable();
+
+      parse_table = new ParseTable();
+      if(!parse_table->create(this, rules, precedences))
+      {
+         deleteParseTable();
+         return false;
+      }
+
+      return true;
+   }
+
+   void Grammar::deleteParseTable()
+   {
+      delete parse_table;
+      parse_table = nullptr;
+   }
+
+   const ParseTable* Grammar::getParseTable() const
+   {
+      return parse_table;
+   }
+
+   bool Grammar::createPredictiveTable()
+   {
+      deletePredictiveTable();
+
+      predictive_table = new PredictiveTable();
+      if(!predictive_table->create(this, rules))
+      {
+         deletePredictiveTable();
+         return false;
+      }
+
+      return predictive_table->getConflicts().empty();
+   }
+
+   void Grammar::deletePredictiveTable()
+   {
+      delete predictive_table;
+      predictive_table = nullptr;
+   }
+
+   const PredictiveTable* Grammar::getPredictiveTable() const
+   {
+      return predictive_table;
+   }
+
+   bool Grammar::createEarleyParser()
+   {
+      deleteEarleyParser();
+
+      earley_parser = new EarleyParser();
+      if(!earley_parser->create(this, rules))
+      {
+         deleteEarleyParser();
+         return false;
+      }
+
+      return true;
    }
 
-   bool Grammar::parse(const string& text, uint32_t& pos) const
+   void Grammar::deleteEarleyParser()
+   {
+      delete earley_parser;
+      earley_parser = nullptr;
+   }
+
+   const EarleyParser* Grammar::getEarleyParser() const
+   {
+      return earley_parser;
+   }
+
+   bool Grammar::parse(string_view text, uint64_t& pos) const
    {
       return parse(text, pos, text.size());
    }
 
-   bool Grammar::parse(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool Grammar::parse(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
+      return parseText(text, pos, last_pos, false);
+   }
+
+   bool Grammar::parseText(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const
+   {
+      ParseMemo::Scope memo_scope(getParseMemo());
+      CallStack::Scope call_scope(getCallStack());
+
       if(pos >= last_pos)
       {
+         UTF8Analyzer::setEndReached();
          return true;
       }
 
-      int char_count = 0;
-      if(!UTF8Analyzer::countNextChar(text, char_count, pos))
+      if(predictive_table != nullptr && predictive_table->getConflicts().empty())
+      {
+         return predictive_table->parse(text, pos, last_pos, ignore_rest) && !call_scope.isExceeded();
+      }
+
+      if(parse_table != nullptr)
+      {
+         return parse_table->parse(text, pos, last_pos, ignore_rest) && !call_scope.isExceeded();
+      }
+
+      if(earley_parser != nullptr)
+      {
+         return parseForest(text, pos, last_pos, ignore_rest) && !call_scope.isExceeded();
+      }
+
+      uint64_t current_pos = pos;
+      if(!parseFirst(text, current_pos, last_pos) || call_scope.isExceeded())
       {
          return false;
       }
 
-      auto terminal_found = terminal_ref.find(text.substr(pos, char_count));
-      if(terminal_found == terminal_ref.end())
+      /*
+         Una vez que una regla coincide ya no se prueban las demás, así
+         que el análisis externo no vuelve a posiciones anteriores.
+      */
+      if(memo_scope.isOuter())
+      {
+         getParseMemo()->commit(current_pos);
+      }
+
+      while(current_pos < last_pos)
+      {
+         if(!parseContinuation(text, current_pos, last_pos))
+         {
+            if(!ignore_rest)
+            {
+               return false;
+            }
+            break;
+         }
+
+         if(call_scope.isExceeded())
+         {
+            return false;
+         }
+
+         if(memo_scope.isOuter())
+         {
+            getParseMemo()->commit(current_pos);
+         }
+      }
+
+      if(call_scope.isExceeded())
       {
          return false;
       }
 
-      for(auto ref : terminal_found->second)
+      if(current_pos >= last_pos)
+      {
+         UTF8Analyzer::setEndReached();
+      }
+
+      pos = current_pos;
+      return true;
+   }
+
+   bool Grammar::parseFirst(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      if(operators.empty())
       {
-         uint32_t current_pos = pos;
-         if(!ref->checkAndAdvance(text, current_pos, last_pos, true))
+         return parseTerminal(text, pos, last_pos);
+      }
+
+      return parseOperation(text, pos, last_pos, 0);
+   }
+
+   bool Grammar::parseTerminal(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      RuleList rules;
+      bool filter = false;
+      uint32_t char_code = 0;
+
+      uint8_t c = pos < text.size() ? text[pos] : 0;
+      if(pos < text.size() && c < 0x80)
+      {
+         rules = byte_rules[c];
+      }
+      else
+      {
+         int char_count = 0;
+         if(!UTF8Analyzer::countNextChar(text, char_count, pos))
+         {
+            return false;
+         }
+
+         /*
+            Las reglas de un carácter no canónico se filtran una por una; si
+            no se puede decodificar, se prueban todas las de su primer byte.
+         */
+         rules = byte_rules[c];
+         if(UTF8Analyzer::getCharCode(text, pos, char_code))
+         {
+            if(UTF8Analyzer::isCanonical(text, pos, char_count))
+            {
+               auto bound = upper_bound(code_bounds.begin(), code_bounds.end(), char_code);
+               rules = code_rules[bound - code_bounds.begin() - 1];
+            }
+            else filter = true;
+         }
+      }
+
+      for(uint32_t i = rules.begin; i < rules.end; ++i)
+      {
+         auto rule = rule_lists[i];
+         if(filter && !rule->getFirstSet().canStart(char_code, false))
          {
             continue;
          }
 
+         uint64_t current_pos = pos;
+         if(checkRule(rule, false, text, current_pos, last_pos))
+         {
+            pos = current_pos;
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   bool Grammar::parseOperation(string_view text, uint64_t& pos, uint64_t last_pos, uint64_t min_precedence) const
+   {
+      uint64_t current_pos = pos;
+
+      const Operator* prefix = nullptr;
+      for(auto& op : operators)
+      {
+         uint64_t symbol_end = current_pos;
+         if(op.type == PREFIX && ParseMemo::check(op.symbol, text, symbol_end, last_pos) && symbol_end > current_pos)
+         {
+            prefix = &op;
+            current_pos = symbol_end;
+            break;
+         }
+      }
+
+      if(prefix != nullptr)
+      {
+         auto parse_operand = [&] {
+            return parseOperation(text, current_pos, last_pos, prefix->precedence);
+         };
+
+         if(!CallStack::call(parse_operand))
+         {
+            return false;
+         }
+
+         if(prefix->function)
+         {
+            callFactoryFunction(prefix->function, ParseProduct(pos, current_pos));
+         }
+      }
+      else if(!parseTerminal(text, current_pos, last_pos))
+      {
+         return false;
+      }
+
+      /*
+         Cada operador se queda con las operaciones de mayor precedencia a
+         su derecha; los asociativos a izquierda, también con las de su
+         misma precedencia a su izquierda.
+      */
+      while(true)
+      {
          if(current_pos >= last_pos)
+         {
+            UTF8Analyzer::setEndReached();
+            break;
+         }
+
+         const uint64_t symbol_pos = current_pos;
+         const Operator* applied = nullptr;
+         for(auto& op : operators)
+         {
+            if(op.type == PREFIX || op.precedence < min_precedence)
+            {
+               continue;
+            }
+
+            uint64_t symbol_end = current_pos;
+            if(ParseMemo::check(op.symbol, text, symbol_end, last_pos) && symbol_end > current_pos)
+            {
+               applied = &op;
+               current_pos = symbol_end;
+               break;
+            }
+         }
+
+         if(applied == nullptr)
+         {
+            break;
+         }
+
+         /*
+            Si el operador no tiene operando, la operación termina antes
+            del operador, como en las reglas que no continúan.
+         */
+         if(applied->type != POSTFIX)
+         {
+            uint64_t right_precedence = applied->precedence + (applied->type == LEFT_INFIX ? 1 : 0);
+            uint64_t operand_pos = current_pos;
+            auto parse_operand = [&] {
+               return parseOperation(text, operand_pos, last_pos, right_precedence);
+            };
+
+            if(!CallStack::call(parse_operand))
+            {
+               current_pos = symbol_pos;
+               break;
+            }
+            current_pos = operand_pos;
+         }
+
+         if(applied->function)
+         {
+            callFactoryFunction(applied->function, ParseProduct(pos, current_pos));
+         }
+      }
+
+      pos = current_pos;
+      return true;
+   }
+
+   bool Grammar::parseForest(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const
+   {
+      ParseForest forest;
+      if(!earley_parser->parse(text, pos, last_pos, ignore_rest, forest))
+      {
+         return false;
+      }
+
+      forest.produce();
+      return true;
+   }
+
+   bool Grammar::parseContinuation(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      /*
+         Las reglas se eligen por el primer carácter después de los
+         espacios; al final del texto se prueban todas.
+      */
+      const uint64_t end = last_pos < text.size() ? last_pos : text.size();
+
+      uint64_t next_pos = pos;
+      while(next_pos < text.size() && isBlank(text[next_pos]))
+      {
+         ++next_pos;
+      }
+
+      uint32_t key = next_pos < end ? uint8_t(text[next_pos]) : 256;
+      RuleList rules = continuation_rules[next_pos > pos][key];
+
+      /*
+         Una continuación que no avanza se repetiría para siempre, así que
+         no cuenta.
+      */
+      for(uint32_t i = rules.begin; i < rules.end; ++i)
+      {
+         auto rule = rule_lists[i];
+         uint64_t current_pos = pos;
+         if(checkRule(rule, true, text, current_pos, last_pos) && current_pos > pos)
          {
             pos = current_pos;
             return true;
          }
+      }
+
+      return false;
+   }
 
-         bool repeat = false;
-         while(true)
+   bool Grammar::checkRule(const LanguageExpression* rule, bool jump, string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      /*
+         Sin conflictos cada regla se prueba a lo sumo una vez en cada
+         posición de un análisis, así que no se guarda su resultado; las
+         tablas ya descartaron las que no pueden empezar en pos.
+      */
+      if(conflicts.empty())
+      {
+         return CallStack::call([&] {
+            if(jump)
+            {
+               return rule->jumpAndCheck(text, pos, last_pos);
+            }
+            return rule->checkAndAdvance(text, pos, last_pos, true);
+         });
+      }
+
+      if(jump)
+      {
+         return ParseMemo::jumpAndCheck(rule, text, pos, last_pos);
+      }
+      return ParseMemo::check(rule, text, pos, last_pos);
+   }
+
+   void Grammar::createRuleTables()
+   {
+      rule_lists.clear();
+      conflicts.clear();
+
+      for(uint32_t c = 0; c < 0x80; ++c)
+      {
+         byte_rules[c] = addRuleList(c);
+         addConflict(byte_rules[c], c, false);
+      }
+
+      vector<ByteSearch> first_bytes(terminal_rules.size());
+      for(uint32_t i = 0; i < terminal_rules.size(); ++i)
+      {
+         terminal_rules[i]->getFirstSet().getBytes(first_bytes[i]);
+      }
+
+      for(uint32_t c = 0x80; c < 256; ++c)
+      {
+         RuleList list = { uint32_t(rule_lists.size()), 0 };
+         for(uint32_t i = 0; i < terminal_rules.size(); ++i)
          {
-            repeat = false;
+            if(first_bytes[i].contains(c))
+            {
+               rule_lists.push_back(terminal_rules[i]);
+            }
+         }
+         list.end = rule_lists.size();
 
-            for(auto sec_ref : nonterminal_ref)
+         byte_rules[c] = list;
+         addValueConflict(list);
+      }
+
+      /*
+         Los extremos de los intervalos de todas las reglas parten los
+         códigos no ASCII en tramos donde ninguna regla cambia.
+      */
+      code_bounds = { 0x80 };
+      for(auto rule : terminal_rules)
+      {
+         for(auto& range : rule->getFirstSet().chars.getRanges())
+         {
+            if(range.max >= 0x80)
+            {
+               code_bounds.push_back(range.min > 0x80 ? range.min : 0x80);
+               code_bounds.push_back(range.max + 1);
+            }
+         }
+      }
+      sort(code_bounds.begin(), code_bounds.end());
+      code_bounds.erase(unique(code_bounds.begin(), code_bounds.end()), code_bounds.end());
+
+      code_rules.clear();
+      for(auto bound : code_bounds)
+      {
+         code_rules.push_back(addRuleList(bound));
+         addConflict(code_rules.back(), bound, false);
+      }
+
+      /*
+         Una regla cuya continuación no se conoce se prueba siempre. Las que
+         siguen con espacios se indexan por lo que viene después de ellos.
+      */
+      vector<bool> known(nonterminal_rules.size());
+      vector<JumpBlank> blanks(nonterminal_rules.size());
+      vector<ByteSearch> next_bytes(nonterminal_rules.size());
+      vector<bool> blank_start(nonterminal_rules.size());
+      for(uint32_t i = 0; i < nonterminal_rules.size(); ++i)
+      {
+         FirstSet next_set;
+         known[i] = nonterminal_rules[i]->getJumpSet(next_set, blanks[i]);
+         next_set.getBytes(next_bytes[i]);
+
+         for(uint32_t c = 0; c < 256; ++c)
+         {
+            if(isBlank(c) && next_bytes[i].contains(c))
+            {
+               blank_start[i] = true;
+            }
+         }
+      }
+
+      for(uint32_t after_blank = 0; after_blank < 2; ++after_blank)
+      {
+         for(uint32_t key = 0; key <= 256; ++key)
+         {
+            RuleList list = { uint32_t(rule_lists.size()), 0 };
+            for(uint32_t i = 0; i < nonterminal_rules.size(); ++i)
             {
-               uint32_t sec_current_pos = current_pos;
-               if(!sec_ref->jumpAndCheck(text, sec_current_pos, last_pos))
+               bool candidate;
+               if(!known[i] || key == 256)
                {
-                  continue;
+                  candidate = true;
                }
-
-               if(sec_current_pos >= last_pos)
+               else if(blanks[i] == NO_BLANK)
                {
-                  return true;
+                  /*
+                     Después de espacios, lo que sigue tiene que poder
+                     empezar con alguno de ellos.
+                  */
+                  candidate = after_blank ? bool(blank_start[i]) : next_bytes[i].contains(key);
                }
-               else
+               else if(blanks[i] == REQUIRED_BLANK && !after_blank)
                {
-                  current_pos = sec_current_pos;
-                  repeat = true;
-                  break;
+                  candidate = false;
                }
+               else candidate = next_bytes[i].contains(key);
+
+               if(candidate)
+               {
+                  rule_lists.push_back(nonterminal_rules[i]);
+               }
+            }
+            list.end = rule_lists.size();
+
+            /*
+               Al final del texto no se prueba ninguna regla.
+            */
+            if(key < 256)
+            {
+               addConflict(list, key, true);
             }
 
-            if(!repeat) break;
+            continuation_rules[after_blank][key] = list;
          }
+      }
+   }
 
-         return false;
+   Grammar::RuleList Grammar::addRuleList(uint32_t char_code)
+   {
+      RuleList list = { uint32_t(rule_lists.size()), 0 };
+      for(auto rule : terminal_rules)
+      {
+         if(rule->getFirstSet().canStart(char_code, true))
+         {
+            rule_lists.push_back(rule);
+         }
       }
+      list.end = rule_lists.size();
 
-      return false;
+      return list;
+   }
+
+   void Grammar::addConflict(RuleList rules, uint32_t char_code, bool continuation)
+   {
+      for(uint32_t i = rules.begin; i < rules.end; ++i)
+      {
+         for(uint32_t j = i + 1; j < rules.end; ++j)
+         {
+            addConflict(rule_lists[i], rule_lists[j], char_code, continuation);
+         }
+      }
+   }
+
+   void Grammar::addValueConflict(RuleList rules)
+   {
+      /*
+         Con un carácter no canónico solo se prueban las reglas que aceptan
+         su código como valor, así que dos reglas chocan si comparten
+         alguno. Las que pueden empezar con cualquier carácter ya chocan
+         con las demás en su lista canónica.
+      */
+      for(uint32_t i = rules.begin; i < rules.end; ++i)
+      {
+         auto& first_set = rule_lists[i]->getFirstSet();
+         for(uint32_t j = i + 1; j < rules.end; ++j)
+         {
+            CharClass shared = first_set.value_chars;
+            shared.intersectClass(rule_lists[j]->getFirstSet().value_chars);
+            if(!shared.empty())
+            {
+               addConflict(rule_lists[i], rule_lists[j], shared.getRanges()[0].min, false);
+            }
+         }
+      }
+   }
+
+   void Grammar::addConflict(const LanguageExpression* first, const LanguageExpression* second, uint32_t char_code, bool continuation)
+   {
+      auto same = [&](const Conflict& conflict) {
+         return conflict.first == first && conflict.second == second && conflict.continuation == continuation;
+      };
+
+      if(none_of(conflicts.begin(), conflicts.end(), same))
+      {
+         conflicts.push_back({ first, second, char_code, continuation });
+      }
    }
 
-   bool Grammar::checkAndAdvance(const string& text, uint32_t& init_pos, uint32_t last_pos, bool ignore_rest) const
+   bool Grammar::checkAndAdvance(string_view text, uint64_t& init_pos, uint64_t last_pos, bool ignore_rest) const
    {
-      return parse(text, init_pos, last_pos);
+      return parseText(text, init_pos, last_pos, ignore_rest);
    }
 
-   bool Grammar::jumpAndCheck(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool Grammar::jumpAndCheck(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return true;
    }
 
    void Grammar::clear()
    {
-      terminal_ref.clear();
-      nonterminal_ref.clear();
-      any_terminal_ref.clear();
+      deleteParseTable();
+      deletePredictiveTable();
+      deleteEarleyParser();
+      rules.clear();
+      terminal_rules.clear();
+      nonterminal_rules.clear();
+      createRuleTables();
    }
 }
@@ -1,13 +1,14 @@
 #pragma once
 
 #include <vector>
-#include <map>
 #include <unordered_map>
-#include <set>
-#include <unordered_set>
 #include <string>
+#include <string_view>
 
 #include "LanguageExpression.hpp"
+#include "ParseTable.hpp"
+#include "PredictiveTable.hpp"
+#include "EarleyParser.hpp"
 
 namespace dnc
 {
@@ -16,29 +17,194 @@ namespace dnc
    public:
       Grammar();
       Grammar(const std::vector<const LanguageExpression*>& expressions);
+      Grammar(const Grammar&) = delete;
       ~Grammar();
 
-      InitExpressionChar getInitExpressionChar() const override;
+      Grammar& operator=(const Grammar&) = delete;
+
+      /*
+         Una regla que empieza con la gramática continúa lo ya analizado.
+      */
+      const FirstSet& getFirstSet() const override;
 
       void setExpressions(const std::vector<const LanguageExpression*>& expressions);
 
-      bool parse(const std::string& text, uint32_t& pos) const;
-      bool parse(const std::string& text, uint32_t& pos, uint32_t last_pos) const;
+      /*
+         Si hay operadores, cada operando es un operador prefijo seguido de
+         su operando o una regla que empieza leyendo un carácter, y los
+         operadores infijos y posfijos se aplican según su precedencia
+         (mayor es más fuerte). El símbolo de un operador tiene que avanzar.
+         func se llama con cada operación completa, después de las de sus
+         operandos.
+      */
+      enum OperatorType
+      {
+         PREFIX,
+         LEFT_INFIX,
+         RIGHT_INFIX,
+         POSTFIX
+      };
+
+      void addOperator(const LanguageExpression* symbol, OperatorType type, uint32_t precedence, const FactoryFunction& func = FactoryFunction());
+      void clearOperators();
+
+      /*
+         Dos reglas que se prueban para el mismo carácter, al comienzo del
+         texto o para continuar lo ya analizado. Una regla que puede
+         coincidir sin avanzar se prueba con cualquier carácter y choca con
+         las demás del mismo paso. Sin conflictos, en cada posición se
+         prueba a lo sumo una regla y, si no coincide, no se prueba otra.
+
+         No es un análisis LL(1) (ver createPredictiveTable()): no se usan
+         conjuntos FOLLOW (lo ya analizado se continúa mientras alguna
+         regla coincida), cada regla puede volver atrás dentro de sus
+         comandos y EXP() sigue llamando a la gramática a través de
+         CallStack, así que el tiempo no queda acotado por el largo del
+         texto.
+      */
+      struct Conflict
+      {
+         const LanguageExpression* first;
+         const LanguageExpression* second;
+         uint32_t char_code;
+         bool continuation;
+      };
+
+      const std::vector<Conflict>& getConflicts() const;
+      bool hasRuleConflicts() const;
+
+      /*
+         Con una tabla LALR(1), parse() y EXP() analizan la gramática sin
+         probar reglas (ver ParseTable). La tabla se crea con las reglas y
+         precedencias que hay en ese momento y se borra al cambiar las
+         reglas.
+      */
+      void setRulePrecedence(const LanguageExpression* rule, uint32_t precedence, bool right_associative = false);
+      bool createParseTable();
+      void deleteParseTable();
+      const ParseTable* getParseTable() const;
+
+      /*
+         Una tabla LL(1) sin conflictos analiza la gramática antes que las
+         demás, sin probar reglas (ver PredictiveTable). Si tiene
+         conflictos, createPredictiveTable() devuelve false y la tabla
+         queda solo para consultarlos. Se borra al cambiar las reglas.
+      */
+      bool createPredictiveTable();
+      void deletePredictiveTable();
+      const PredictiveTable* getPredictiveTable() const;
+
+      /*
+         Sin tabla, un EarleyParser analiza la gramática aunque sea ambigua
+         y se usa el árbol de las reglas declaradas antes.
+      */
+      bool createEarleyParser();
+      void deleteEarleyParser();
+      const EarleyParser* getEarleyParser() const;
 
-      bool checkAndAdvance(const std::string& text, uint32_t& init_pos, uint32_t last_pos, bool ignore_rest) const override;
+      /*
+         El análisis tiene que llegar a last_pos. El texto vacío se acepta.
+      */
+      bool parse(std::string_view text, uint64_t& pos) const;
+      bool parse(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
 
-      bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+      /*
+         Sin ignore_rest es igual a parse(). Con ignore_rest, como en check()
+         y en EXP(), se acepta el comienzo del texto que se analiza y se deja
+         el resto; la tabla y el EarleyParser usan el más largo, y las
+         reglas y los operadores, el que alcanzan sin volver atrás. Es igual
+         con todos los análisis: al final del texto se acepta sin avanzar y,
+         si no, solo avanzando.
+      */
+      bool checkAndAdvance(std::string_view text, uint64_t& init_pos, uint64_t last_pos, bool ignore_rest) const override;
+
+      bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
       void clear();
 
    private:
+      friend class StreamSession;
+
       /*
          Este objeto es temporal
       */
       LanguageExpression HERO_EXPRESSION;
 
-      std::unordered_map<std::string, std::set<const LanguageExpression*>> terminal_ref;
-      std::unordered_set<const LanguageExpression*> nonterminal_ref;
-      std::unordered_set<const LanguageExpression*> any_terminal_ref;
+      FirstSet self_set;
+
+      /*
+         Reglas en el orden en que se declararon: todas, las que pueden
+         empezar leyendo un carácter y las que empiezan con la gramática.
+      */
+      std::vector<const LanguageExpression*> rules;
+      std::vector<const LanguageExpression*> terminal_rules;
+      std::vector<const LanguageExpression*> nonterminal_rules;
+
+      /*
+         Tramo de rule_lists con las reglas que se prueban para un carácter,
+         en el mismo orden.
+      */
+      struct RuleList
+      {
+         uint32_t begin;
+         uint32_t end;
+      };
+
+      /*
+         Para cada primer byte, las reglas que pueden empezar con él. Con
+         los bytes ASCII es la lista definitiva; con el resto solo se usa si
+         el carácter no está codificado de forma canónica. Los caracteres
+         canónicos no ASCII se buscan en code_bounds, que tiene el primer
+         código de cada intervalo de code_rules.
+      */
+      std::vector<const LanguageExpression*> rule_lists;
+      RuleList byte_rules[256];
+      std::vector<uint32_t> code_bounds;
+      std::vector<RuleList> code_rules;
+      /*
+         Reglas que continúan lo ya analizado, según haya espacios en pos y
+         según el primer byte después de ellos (256 es el final del texto).
+      */
+      RuleList continuation_rules[2][257];
+      std::vector<Conflict> conflicts;
+
+      struct Operator
+      {
+         const LanguageExpression* symbol;
+         OperatorType type;
+         uint32_t precedence;
+         FactoryFunction function;
+      };
+
+      std::vector<Operator> operators;
+
+      std::vector<ParseTable::Precedence> precedences;
+      ParseTable* parse_table;
+      PredictiveTable* predictive_table;
+      EarleyParser* earley_parser;
+
+      void createRuleTables();
+      RuleList addRuleList(uint32_t char_code);
+      void addConflict(RuleList rules, uint32_t char_code, bool continuation);
+      void addValueConflict(RuleList rules);
+      void addConflict(const LanguageExpression* first, const LanguageExpression* second, uint32_t char_code, bool continuation);
+
+      /*
+         Los dos pasos del análisis: la regla que empieza con el carácter de
+         pos y cada una de las reglas que continúan lo ya analizado. En ambos
+         casos se usa la primera regla que coincide.
+      */
+      bool parseText(std::string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const;
+      bool parseFirst(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+      bool parseTerminal(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+      bool parseContinuation(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+      bool parseForest(std::string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const;
+      bool checkRule(const LanguageExpression* rule, bool jump, std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+
+      /*
+         Analiza un operando y los operadores con al menos min_precedence
+         que le siguen.
+      */
+      bool parseOperation(std::string_view text, uint64_t& pos, uint64_t last_pos, uint64_t min_precedence) const;
    };
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "GrammarProductions.hpp"
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace dnc
+{
+   const int32_t GrammarProductions::NONTERMINAL = -1;
+
+   GrammarProductions::GrammarProductions()
+   {}
+
+   GrammarProductions::~GrammarProductions()
+   {}
+
+   bool GrammarProductions::create(const LanguageExpression* grammar, const vector<const LanguageExpression*>& rules)
+   {
+      clear();
+
+      map<string, uint32_t> token_ids;
+      for(auto rule : rules)
+      {
+         Production production = { rule, {} };
+
+         auto& commands = rule->compiled->command_sequence;
+         uint32_t begin = 0;
+         for(uint32_t i = 0; i <= commands.size(); ++i)
+         {
+            bool call = false;
+            if(i < commands.size())
+            {
+               auto command = dynamic_cast<const LanguageExpression::EXPCommand*>(commands[i]);
+               call = command != nullptr && command->getExpression() == grammar;
+
+               if(!call)
+               {
+                  continue;
+               }
+            }
+
+            if(i > begin)
+            {
+               string key;
+               for(uint32_t j = begin; j < i; ++j)
+               {
+                  key += commands[j]->toString() + "\n";
+               }
+
+               auto found = token_ids.find(key);
+               if(found == token_ids.end())
+               {
+                  Token token = { rule, begin, i, ByteSearch(), false, ByteSearch() };
+
+                  LanguageExpression::FirstSet first_set;
+                  first_set.nullable = true;
+                  for(uint32_t j = begin; j < i; ++j)
+                  {
+                     first_set.appendSet(commands[j]->getFirstSet());
+                  }
+                  first_set.getBytes(token.first_bytes);
+
+                  uint32_t next = begin;
+                  while(next < i && isBlank(commands[next]))
+                  {
+                     ++next;
+                  }
+
+                  if(next > begin)
+                  {
+                     LanguageExpression::FirstSet next_set;
+                     next_set.nullable = true;
+                     for(uint32_t j = next; j < i; ++j)
+                     {
+                        next_set.appendSet(commands[j]->getFirstSet());
+                     }
+                     next_set.getBytes(token.next_bytes);
+                     token.blank = true;
+                  }
+
+                  found = token_ids.insert({ key, tokens.size() }).first;
+                  tokens.push_back(token);
+               }
+
+               production.symbols.push_back(found->second);
+            }
+
+            if(call)
+            {
+               production.symbols.push_back(NONTERMINAL);
+            }
+            begin = i + 1;
+         }
+
+         if(production.symbols.empty() || (production.symbols.size() == 1 && production.symbols[0] == NONTERMINAL))
+         {
+            clear();
+            return false;
+         }
+
+         productions.push_back(production);
+      }
+
+      return true;
+   }
+
+   void GrammarProductions::clear()
+   {
+      tokens.clear();
+      productions.clear();
+   }
+
+   const vector<GrammarProductions::Token>& GrammarProductions::getTokens() const
+   {
+      return tokens;
+   }
+
+   const vector<GrammarProductions::Production>& GrammarProductions::getProductions() const
+   {
+      return productions;
+   }
+
+   bool GrammarProductions::matchToken(uint32_t token, string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      auto& info = tokens[token];
+      if(pos < text.size() && !info.first_bytes.contains(text[pos]))
+      {
+         return false;
+      }
+
+      auto& commands = info.rule->compiled->command_sequence;
+      uint64_t current_pos = pos;
+      for(uint32_t i = info.begin; i < info.end; ++i)
+      {
+         if(!commands[i]->check(text, current_pos, last_pos))
+         {
+            return false;
+         }
+      }
+
+      /*
+         Un terminal que no avanza podría reconocerse para siempre.
+      */
+      if(current_pos == pos)
+      {
+         return false;
+      }
+
+      pos = current_pos;
+      return true;
+   }
+
+   bool GrammarProductions::canOverlap(uint32_t first, uint32_t second) const
+   {
+      auto& first_token = tokens[first];
+      auto& second_token = tokens[second];
+
+      bool blank = first_token.blank && second_token.blank;
+      auto& first_bytes = blank ? first_token.next_bytes : first_token.first_bytes;
+      auto& second_bytes = blank ? second_token.next_bytes : second_token.first_bytes;
+
+      for(uint32_t byte = 0; byte < 256; ++byte)
+      {
+         if(first_bytes.contains(byte) && second_bytes.contains(byte))
+         {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   bool GrammarProductions::isBlank(const LanguageExpression::Command* command)
+   {
+      return dynamic_cast<const LanguageExpression::BLANKCommand*>(command) != nullptr || dynamic_cast<const LanguageExpression::OPTBLANKCommand*>(command) != nullptr;
+   }
+
+   void GrammarProductions::produce(uint32_t production, const ParseProduct& product) const
+   {
+      auto rule = productions[production].rule;
+      if(rule->has_factory_function)
+      {
+         LanguageExpression::callFactoryFunction(rule->factory_function, product);
+      }
+   }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "ByteSearch.hpp"
+
+namespace dnc
+{
+   /*
+      Reglas de una gramática vistas como producciones: las llamadas a la
+      gramática con EXP() que no están dentro de otro comando son el no
+      terminal y cada tramo de comandos entre ellas es un terminal. Los
+      tramos con los mismos comandos son el mismo terminal. Los terminales
+      se reconocen con sus propios comandos y tienen que avanzar, así que
+      la gramática no coincide sin avanzar.
+   */
+   class GrammarProductions
+   {
+   public:
+      static const int32_t NONTERMINAL;
+
+      /*
+         Si el terminal empieza con espacios (- o _), next_bytes son los
+         bytes con los que puede seguir después de ellos.
+      */
+      struct Token
+      {
+         const LanguageExpression* rule;
+         uint32_t begin;
+         uint32_t end;
+         ByteSearch first_bytes;
+         bool blank;
+         ByteSearch next_bytes;
+      };
+
+      struct Production
+      {
+         const LanguageExpression* rule;
+         std::vector<int32_t> symbols;
+      };
+
+      GrammarProductions();
+      ~GrammarProductions();
+
+      /*
+         Falla si alguna regla no tiene comandos o es solo una llamada a la
+         gramática.
+      */
+      bool create(const LanguageExpression* grammar, const std::vector<const LanguageExpression*>& rules);
+      void clear();
+
+      const std::vector<Token>& getTokens() const;
+      const std::vector<Production>& getProductions() const;
+
+      bool matchToken(uint32_t token, std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+
+      /*
+         Indica si los dos terminales pueden empezar a coincidir con el
+         mismo texto. Los espacios del comienzo se saltean enteros, así que
+         entre dos terminales que empiezan con ellos decide lo que sigue.
+      */
+      bool canOverlap(uint32_t first, uint32_t second) const;
+
+      /*
+         Llama a la función de fábrica de la regla de la producción.
+      */
+      void produce(uint32_t production, const ParseProduct& product) const;
+
+   private:
+      std::vector<Token> tokens;
+      std::vector<Production> productions;
+
+      static bool isBlank(const LanguageExpression::Command* command);
+   };
+}
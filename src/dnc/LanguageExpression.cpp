@@ -1,7 +1,11 @@
 #include "LanguageExpression.hpp"
 
+#include <algorithm>
 #include <iostream>
 
+#include "CommandProgram.hpp"
+#include "CommandRegistry.hpp"
+#include "Grammar.hpp"
 #include "StringUtils.hpp"
 #include "UTF8Analyzer.hpp"
 #include "UTF8Tokenizator.hpp"
@@ -10,28 +14,78 @@ using namespace std;
 
 namespace dnc
 {
-   bool createCommandSequence(vector<LanguageExpression::Command*>& sequence, LanguageExpression::CommandScope& scope, const std::string& text, uint32_t pos, uint32_t last_pos)
+   namespace
    {
-      while(pos < text.size())
+      /*
+         Tabla de un hash perfecto de los nombres de los comandos. Con el
+         primer carácter, el último y el largo no hay dos nombres en la
+         misma casilla; createCommandSlots() lo comprueba al compilar.
+      */
+      constexpr uint32_t COMMAND_SLOT_COUNT = 64;
+
+      constexpr uint32_t hashCommandName(string_view name)
+      {
+         return (uint8_t(name[0]) + 4 * uint8_t(name.back()) + 19 * name.size()) % COMMAND_SLOT_COUNT;
+      }
+
+      /*
+         Cada casilla tiene el índice del creador más uno, o 0 si está
+         vacía.
+      */
+      struct CommandSlots
       {
-       LanguageExpression::Command* current_command;
-         if(!scope.createCommand(current_command, text, pos, last_pos))
+         uint8_t entries[COMMAND_SLOT_COUNT];
+         bool perfect;
+      };
+
+      template<typename Entry, size_t ENTRY_COUNT>
+      constexpr CommandSlots createCommandSlots(const Entry (&creators)[ENTRY_COUNT])
+      {
+         CommandSlots slots = {};
+         slots.perfect = true;
+
+         for(uint32_t i = 0; i < ENTRY_COUNT; ++i)
          {
-            for(auto c : sequence)
+            uint8_t& slot = slots.entries[hashCommandName(creators[i].name)];
+            if(slot != 0)
             {
-               delete c;
+               slots.perfect = false;
             }
-
-            return false;
+            slot = i + 1;
          }
 
-         sequence.push_back(current_command);
+         return slots;
+      }
+
+      bool isBlank(char c)
+      {
+         return uint8_t(c) <= 32 || c == 127;
+      }
+
+      bool isDigit(char c)
+      {
+         return c >= '0' && c <= '9';
+      }
+
+      bool isLetter(char c)
+      {
+         return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+      }
+
+      /*
+         Cada parte de una clave lleva su largo, para que dos claves iguales
+         tengan las mismas partes.
+      */
+      void appendKeyPart(string& key, const void* data, uint32_t size)
+      {
+         key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+         key.append(static_cast<const char*>(data), size);
       }
-     
-     return true;
    }
 
-   const map<string, LanguageExpression::CommandCreator> LanguageExpression::COMMAND_CREATORS = {
+   const uint32_t LanguageExpression::NO_ERROR_POS = uint32_t(-1);
+
+   constexpr LanguageExpression::CommandCreatorEntry LanguageExpression::COMMAND_CREATORS[] = {
       {"UCHAR", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
          if(args.size() != 1)
          {
@@ -43,7 +97,7 @@ namespace dnc
             return false;
          }
 
-         command = new UCHARCommand(move(args[0].value));
+         command = scope.arena->create<UCHARCommand>(move(args[0].value));
          return true;
       }},
 
@@ -53,7 +107,7 @@ namespace dnc
             return false;
          }
 
-         command = new CHARCommand();
+         command = scope.arena->create<CHARCommand>();
          return true;
       }},
 
@@ -63,14 +117,14 @@ namespace dnc
             return false;
          }
 
-         command = new STRCommand(move(args[0].value));
+         command = scope.arena->create<STRCommand>(move(args[0].value));
          return true;
       }},
 
       {"NUM", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
          if(args.size() == 0)
          {
-            command = new NUMCommand(0, 9);
+            command = scope.arena->create<NUMCommand>(0, 9);
          }
          else if(args.size() == 1)
          {
@@ -83,7 +137,7 @@ namespace dnc
             {
                return false;
             }
-            command = new NUMCommand(num);
+            command = scope.arena->create<NUMCommand>(num);
             return true;
          }
          else if(args.size() == 2)
@@ -110,7 +164,7 @@ namespace dnc
             {
                return false;
             }
-            command = new NUMCommand(num1, num2);
+            command = scope.arena->create<NUMCommand>(num1, num2);
             return true;
          }
 
@@ -120,20 +174,20 @@ namespace dnc
       {"NUMT", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
          if(args.size() == 0)
          {
-            command = new NUMTCommand();
+            command = scope.arena->create<NUMTCommand>();
             return true;
          }
          else if(args.size() == 1)
          {
             double num = atof(args[0].value.c_str());
-            command = new NUMTCommand(num);
+            command = scope.arena->create<NUMTCommand>(num);
             return true;
          }
          else if(args.size() == 2)
          {
             double num1 = atof(args[0].value.c_str());
             double num2 = atof(args[1].value.c_str());
-            command = new NUMTCommand(num1, num2);
+            command = scope.arena->create<NUMTCommand>(num1, num2);
             return true;
          }
 
@@ -143,7 +197,7 @@ namespace dnc
       {"INUMT", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
          if(args.size() == 0)
          {
-            command = new INUMTCommand();
+            command = scope.arena->create<INUMTCommand>();
             return true;
          }
          else if(args.size() == 1)
@@ -153,7 +207,7 @@ namespace dnc
             {
                return false;
             }
-            command = new INUMTCommand(num);
+            command = scope.arena->create<INUMTCommand>(num);
             return true;
          }
          else if(args.size() == 2)
@@ -168,7 +222,7 @@ namespace dnc
             {
                return false;
             }
-            command = new INUMTCommand(num1, num2);
+            command = scope.arena->create<INUMTCommand>(num1, num2);
             return true;
          }
 
@@ -181,7 +235,7 @@ namespace dnc
             return false;
          }
 
-         command = new BLANKCommand();
+         command = scope.arena->create<BLANKCommand>();
          return true;
       }},
 
@@ -191,7 +245,7 @@ namespace dnc
             return false;
          }
 
-         command = new OPTBLANKCommand();
+         command = scope.arena->create<OPTBLANKCommand>();
          return true;
       }},
 
@@ -201,27 +255,24 @@ namespace dnc
             return false;
          }
 
-         vector<Command*> command_sequence;
-         string& expression = args[0].value;
-         uint32_t pos = 0;
-
-         if(!createCommandSequence(command_sequence, scope, expression, pos, expression.size()))
+         CommandList command_sequence;
+         if(!takeSequence(args[0], scope, command_sequence))
          {
             return false;
          }
 
          if(args.size() == 1)
          {
-            command = new REPCommand(command_sequence);
+            command = scope.arena->create<REPCommand>(command_sequence);
             return true;
          }
          else if(args.size() == 2)
          {
-            command = new REPCommand(command_sequence, atof(args[1].value.c_str()));
+            command = scope.arena->create<REPCommand>(command_sequence, atof(args[1].value.c_str()));
             return true;
          }
 
-         command = new REPCommand(command_sequence, atof(args[1].value.c_str()), atof(args[2].value.c_str()));
+         command = scope.arena->create<REPCommand>(command_sequence, atof(args[1].value.c_str()), atof(args[2].value.c_str()));
          return true;
       }},
 
@@ -231,26 +282,16 @@ namespace dnc
             return false;
          }
 
-         vector<Command*> command_sequence;
-         string& seq_expression = args[0].value;
-         uint32_t pos = 0;
-
-         if(!createCommandSequence(command_sequence, scope, seq_expression, pos, seq_expression.size()))
-         {
-            return false;
-         }
-
-         vector<Command*> condition_sequence;
-         string& con_expression = args[1].value;
-
-         if(!createCommandSequence(condition_sequence, scope, con_expression, pos, con_expression.size()))
+         CommandList command_sequence;
+         CommandList condition_sequence;
+         if(!takeSequence(args[0], scope, command_sequence) || !takeSequence(args[1], scope, condition_sequence))
          {
             return false;
          }
 
          if(args.size() == 2)
          {
-            command = new REPIFCommand(command_sequence, condition_sequence);
+            command = scope.arena->create<REPIFCommand>(command_sequence, condition_sequence);
             return true;
          }
 
@@ -259,16 +300,16 @@ namespace dnc
          if(args.size() == 3)
          {
             
-            command = new REPIFCommand(command_sequence, condition_sequence, ignore);
+            command = scope.arena->create<REPIFCommand>(command_sequence, condition_sequence, ignore);
             return true;
          }
          if(args.size() == 4)
          {
-            command = new REPIFCommand(command_sequence, condition_sequence, ignore, atof(args[3].value.c_str()));
+            command = scope.arena->create<REPIFCommand>(command_sequence, condition_sequence, ignore, atof(args[3].value.c_str()));
             return true;
          }
 
-         command = new REPIFCommand(command_sequence, condition_sequence, ignore, atof(args[3].value.c_str()), atof(args[4].value.c_str()));
+         command = scope.arena->create<REPIFCommand>(command_sequence, condition_sequence, ignore, atof(args[3].value.c_str()), atof(args[4].value.c_str()));
          return true;
       }},
 
@@ -278,22 +319,13 @@ namespace dnc
             return false;
          }
 
-         vector<Command*> first, second;
-         string& first_expression = args[0].value;
-         string& second_expression = args[1].value;
-         uint32_t pos = 0;
-
-         if(!createCommandSequence(first, scope, first_expression, pos, first_expression.size()))
-         {
-            return false;
-         }
-
-         if(!createCommandSequence(second, scope, second_expression, pos, second_expression.size()))
+         CommandList first, second;
+         if(!takeSequence(args[0], scope, first) || !takeSequence(args[1], scope, second))
          {
             return false;
          }
 
-         command = new ORCommand(first, second);
+         command = scope.arena->create<ORCommand>(first, second);
          return true;
       }},
 
@@ -303,22 +335,13 @@ namespace dnc
             return false;
          }
 
-         vector<Command*> first, second;
-         string& first_expression = args[0].value;
-         string& second_expression = args[1].value;
-         uint32_t pos = 0;
-
-         if(!createCommandSequence(first, scope, first_expression, pos, first_expression.size()))
-         {
-            return false;
-         }
-
-         if(!createCommandSequence(second, scope, second_expression, pos, second_expression.size()))
+         CommandList first, second;
+         if(!takeSequence(args[0], scope, first) || !takeSequence(args[1], scope, second))
          {
             return false;
          }
 
-         command = new XORCommand(first, second);
+         command = scope.arena->create<XORCommand>(first, second);
          return true;
       }},
 
@@ -328,16 +351,13 @@ namespace dnc
             return false;
          }
 
-         vector<Command*> sequence;
-         string& expression = args[0].value;
-         uint32_t pos = 0;
-
-         if(!createCommandSequence(sequence, scope, expression, pos, expression.size()))
+         CommandList sequence;
+         if(!takeSequence(args[0], scope, sequence))
          {
             return false;
          }
 
-         command = new OPTCommand(sequence);
+         command = scope.arena->create<OPTCommand>(sequence);
          return true;
       }},
 
@@ -354,7 +374,7 @@ namespace dnc
             return false;
          }
 
-         command = new EXPCommand(scope.expressions[exp_pos]);
+         command = scope.arena->create<EXPCommand>(scope.expressions[exp_pos]);
          return true;
       }},
 
@@ -372,7 +392,7 @@ namespace dnc
             return false;
          }
 
-         command = new RANGECommand(min, max);
+         command = scope.arena->create<RANGECommand>(min, max);
          return true;
       }},
 
@@ -382,7 +402,7 @@ namespace dnc
             return false;
          }
 
-         command = new LETTERCommand();
+         command = scope.arena->create<LETTERCommand>();
          return true;
       }},
 
@@ -392,7 +412,7 @@ namespace dnc
             return false;
          }
 
-         command = new UPPERLETTERCommand();
+         command = scope.arena->create<UPPERLETTERCommand>();
          return true;
       }},
 
@@ -402,12 +422,12 @@ namespace dnc
             return false;
          }
 
-         command = new LOWERLETTERCommand();
+         command = scope.arena->create<LOWERLETTERCommand>();
          return true;
       }},
 
       {"S", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
-         command = new SETCommand();
+         command = scope.arena->create<SETCommand>();
 
          for(uint32_t i = 0; i < args.size(); ++i)
          {
@@ -419,23 +439,12 @@ namespace dnc
 
             if(args[i].type != LanguageExpression::CommandToken::COMMAND_SEQUENCE)
             {
-               delete command;
-               return false;
-            }
-
-            vector<Command*> sequence;
-            string& expression = args[i].value;
-            uint32_t pos = 0;
-
-            if(!createCommandSequence(sequence, scope, expression, pos, expression.size()))
-            {
-               delete command;
                return false;
             }
 
-            if(sequence.size() > 1)
+            auto& sequence = args[i].sequence;
+            if(sequence.size() != 1)
             {
-               delete command;
                return false;
             }
 
@@ -448,70 +457,143 @@ namespace dnc
       }},
 
       {"SWITCH", [](Command*& command, LanguageExpression::CommandArgs& args, LanguageExpression::CommandScope& scope) -> bool {
-         command = new SWITCHCommand();
-
+         vector<Command*> commands;
          for(uint32_t i = 0; i < args.size(); ++i)
          {
-            if(args[i].type != LanguageExpression::CommandToken::COMMAND_SEQUENCE)
-            {
-               delete command;
-               return false;
-            }
-
-            vector<Command*> sequence;
-            string& expression = args[i].value;
-            uint32_t pos = 0;
-
-            if(!createCommandSequence(sequence, scope, expression, pos, expression.size()))
-            {
-               delete command;
-               return false;
-            }
-
-            if(sequence.size() > 1)
+            if(args[i].type != LanguageExpression::CommandToken::COMMAND_SEQUENCE || args[i].sequence.size() != 1)
             {
-               delete command;
                return false;
             }
 
-            reinterpret_cast<SWITCHCommand*>(command)->addCommand(sequence[0]);
+            commands.push_back(args[i].sequence[0]);
          }
 
+         command = scope.arena->create<SWITCHCommand>(scope.arena->createArray(commands));
          return true;
       }},
    };
 
+   thread_local LanguageExpression::FactoryCalls* LanguageExpression::deferred_factory_calls = nullptr;
+
    LanguageExpression::LanguageExpression() :
-      has_factory_function(false)
-   {
-      command_scope.createCommand = [this](Command*& a, const std::string& b, uint32_t& c, uint32_t d) -> bool
-      {
-         return this->createCommand(a, b, c, d);
-      };
-   }
+      compiled(getEmptyCompiled()),
+      error_pos(NO_ERROR_POS),
+      has_factory_function(false),
+      parse_memo(nullptr),
+      call_stack(nullptr),
+      command_registry(nullptr)
+   {}
 
    LanguageExpression::LanguageExpression(const string& expression, const vector<const LanguageExpression*>& expressions) :
-      has_factory_function(false)
+      compiled(getEmptyCompiled()),
+      error_pos(NO_ERROR_POS),
+      has_factory_function(false),
+      parse_memo(nullptr),
+      call_stack(nullptr),
+      command_registry(nullptr)
    {
-      command_scope.createCommand = [this](Command*& a, const std::string& b, uint32_t& c, uint32_t d) -> bool
-      {
-         return this->createCommand(a, b, c, d);
-      };
       create(expression, 0, expressions);
    }
 
+   LanguageExpression::LanguageExpression(const LanguageExpression& other) :
+      compiled(other.compiled),
+      error_pos(other.error_pos),
+      has_factory_function(other.has_factory_function),
+      factory_function(other.factory_function),
+      parse_memo(other.parse_memo),
+      call_stack(other.call_stack),
+      command_registry(other.command_registry)
+   {}
+
+   LanguageExpression::LanguageExpression(LanguageExpression&& other) :
+      compiled(move(other.compiled)),
+      error_pos(other.error_pos),
+      has_factory_function(other.has_factory_function),
+      factory_function(move(other.factory_function)),
+      parse_memo(other.parse_memo),
+      call_stack(other.call_stack),
+      command_registry(other.command_registry)
+   {
+      other.clear();
+      other.has_factory_function = false;
+   }
+
    LanguageExpression::~LanguageExpression()
+   {}
+
+   LanguageExpression& LanguageExpression::operator=(const LanguageExpression& other)
+   {
+      compiled = other.compiled;
+      error_pos = other.error_pos;
+      has_factory_function = other.has_factory_function;
+      factory_function = other.factory_function;
+      parse_memo = other.parse_memo;
+      call_stack = other.call_stack;
+      command_registry = other.command_registry;
+
+      return *this;
+   }
+
+   LanguageExpression& LanguageExpression::operator=(LanguageExpression&& other)
+   {
+      if(this == &other)
+      {
+         return *this;
+      }
+
+      compiled = move(other.compiled);
+      error_pos = other.error_pos;
+      has_factory_function = other.has_factory_function;
+      factory_function = move(other.factory_function);
+      parse_memo = other.parse_memo;
+      call_stack = other.call_stack;
+      command_registry = other.command_registry;
+
+      other.clear();
+      other.has_factory_function = false;
+
+      return *this;
+   }
+
+   const LanguageExpression::FirstSet& LanguageExpression::getFirstSet() const
    {
-      clear();
+      return compiled->first_set;
    }
 
-   LanguageExpression::InitExpressionChar LanguageExpression::getInitExpressionChar() const
+   bool LanguageExpression::getJumpSet(FirstSet& next_set, JumpBlank& blank) const
    {
-      if(command_sequence.size() > 0)
+      auto& command_sequence = compiled->command_sequence;
+      if(command_sequence.size() == 0 || dynamic_cast<const EXPCommand*>(command_sequence[0]) == nullptr)
+      {
+         return false;
+      }
+
+      uint32_t i = 1;
+      blank = NO_BLANK;
+      if(i < command_sequence.size() && dynamic_cast<const OPTBLANKCommand*>(command_sequence[i]) != nullptr)
+      {
+         blank = OPTIONAL_BLANK;
+         ++i;
+      }
+      else if(i < command_sequence.size() && dynamic_cast<const BLANKCommand*>(command_sequence[i]) != nullptr)
+      {
+         blank = REQUIRED_BLANK;
+         ++i;
+      }
+
+      next_set = FirstSet();
+      next_set.nullable = true;
+      for(; i < command_sequence.size(); ++i)
       {
-         return command_sequence[0]->getInitExpressionChar();
+         next_set.appendSet(command_sequence[i]->getFirstSet());
       }
-      return { ExpressionChar("") };
+
+      return true;
+   }
+
+   bool LanguageExpression::canStartAt(string_view text, uint64_t pos, uint64_t last_pos) const
+   {
+      return canStart(compiled->first_bytes, text, pos, last_pos);
    }
 
    void LanguageExpression::setFactoryFunction(const FactoryFunction& func)
@@ -525,6 +607,51 @@ namespace dnc
       has_factory_function = false;
    }
 
+   void LanguageExpression::setParseMemo(ParseMemo* memo)
+   {
+      parse_memo = memo;
+   }
+
+   void LanguageExpression::resetParseMemo()
+   {
+      parse_memo = nullptr;
+   }
+
+   ParseMemo* LanguageExpression::getParseMemo() const
+   {
+      return parse_memo;
+   }
+
+   void LanguageExpression::setCallStack(CallStack* stack)
+   {
+      call_stack = stack;
+   }
+
+   void LanguageExpression::resetCallStack()
+   {
+      call_stack = nullptr;
+   }
+
+   CallStack* LanguageExpression::getCallStack() const
+   {
+      return call_stack;
+   }
+
+   void LanguageExpression::setCommandRegistry(CommandRegistry* registry)
+   {
+      command_registry = registry;
+   }
+
+   void LanguageExpression::resetCommandRegistry()
+   {
+      command_registry = nullptr;
+   }
+
+   CommandRegistry* LanguageExpression::getCommandRegistry() const
+   {
+      return command_registry;
+   }
+
    bool LanguageExpression::create(const string& text, uint32_t init_pos, const vector<const LanguageExpression*>& expressions)
    {
       return create(text, init_pos, text.size(), expressions);
@@ -532,79 +659,107 @@ namespace dnc
 
    bool LanguageExpression::create(const string& text, uint32_t init_pos, uint32_t last_pos, const vector<const LanguageExpression*>& expressions)
    {
-      command_scope.expressions = expressions;
-
       if(last_pos > text.size())
       {
          last_pos = text.size();
       }
 
+      string_view expression(text.data(), last_pos);
       uint32_t pos = init_pos;
+      error_pos = NO_ERROR_POS;
+
+      /*
+         Los comandos se compilan aparte y reemplazan a los anteriores solo
+         si todo el texto es válido. Las copias que comparten los anteriores
+         no cambian.
+      */
+      Compiled* result = new Compiled();
+      CommandScope scope = { expressions, &result->arena, command_registry };
 
       vector<Command*> current_command_sequence;
       while(pos < last_pos)
       {
          Command* command;
-         if(!createCommand(command, text, pos, last_pos))
+         if(!createCommand(command, expression, pos, scope))
          {
-            for(auto c : current_command_sequence)
-            {
-               delete c;
-            }
-
+            delete result;
             return false;
          }
 
          current_command_sequence.push_back(command);
       }
 
-      clear();
-      command_sequence = move(current_command_sequence);
+      result->command_sequence = result->arena.createArray(current_command_sequence);
+      result->createFirstSet();
+      result->createRegularMatcher();
+      result->createCommandProgram();
+      result->createStartBytes();
+      result->createRequiredLiteral(!expressions.empty());
 
+      compiled.reset(result);
       return true;
    }
 
-   bool LanguageExpression::check(const string& text, uint32_t init_pos, bool ignore_rest) const
+   bool LanguageExpression::check(string_view text, uint64_t init_pos, bool ignore_rest) const
    {
       return checkAndAdvance(text, init_pos, text.size(), ignore_rest);
    }
 
-   bool LanguageExpression::check(const string& text, uint32_t init_pos, uint32_t last_pos, bool ignore_rest) const
+   bool LanguageExpression::check(string_view text, uint64_t init_pos, uint64_t last_pos, bool ignore_rest) const
    {
       return checkAndAdvance(text, init_pos, last_pos, ignore_rest);
    }
 
-   bool LanguageExpression::checkAndAdvance(const string& text, uint32_t& pos, uint32_t last_pos, bool ignore_rest) const
+   bool LanguageExpression::checkAndAdvance(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const
    {
-      uint32_t init_pos = pos;
+      ParseMemo::Scope memo_scope(parse_memo);
+      CallStack::Scope call_scope(call_stack);
+      uint64_t init_pos = pos;
 
-      for(auto command : command_sequence)
+      /*
+         Si la coincidencia tiene que llegar al final del texto, se recorre
+         todo igual, así que conviene buscar antes el texto requerido.
+      */
+      if(!ignore_rest && !compiled->required_literal.infix.empty() && ByteSearch::findString(text, pos, compiled->required_literal.infix) >= text.size())
       {
-         if(!command->check(text, pos, last_pos))
-         {
-            return false;
-         }
+         UTF8Analyzer::setEndReached();
+         return false;
+      }
+
+      if(!matchCommands(text, pos, last_pos) || call_scope.isExceeded())
+      {
+         return false;
       }
 
-      if(ignore_rest || pos >= text.size())
+      if(!ignore_rest)
       {
-         if(has_factory_function)
+         if(pos < text.size())
          {
-            factory_function(ParseProduct(init_pos, pos));
+            return false;
          }
-         return true;
+         UTF8Analyzer::setEndReached();
       }
 
-      return false;
+      if(has_factory_function)
+      {
+         callFactoryFunction(factory_function, ParseProduct(init_pos, pos));
+      }
+      return true;
    }
 
-   bool LanguageExpression::jumpAndCheck(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::jumpAndCheck(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
+      auto& command_sequence = compiled->command_sequence;
       if(command_sequence.size() == 0)
       {
          return false;
       }
 
+      if(compiled->command_program != nullptr && compiled->jump_entry != 0)
+      {
+         return compiled->command_program->run(text, pos, last_pos, compiled->jump_entry);
+      }
+
       if(!command_sequence[0]->jumpAndCheck(text, pos, last_pos))
       {
          return false;
@@ -621,29 +776,109 @@ namespace dnc
       return true;
    }
 
-   void LanguageExpression::clear()
+   bool LanguageExpression::find(string_view text, ParseProduct& product, uint64_t init_pos) const
    {
-      for(auto command : command_sequence)
+      auto& required_literal = compiled->required_literal;
+      auto& start_bytes = compiled->start_bytes;
+      const string& prefix = required_literal.prefix;
+      const string& infix = required_literal.infix;
+
+      uint64_t pos = init_pos;
+      uint64_t infix_pos = 0;
+      bool has_infix_pos = false;
+      while(true)
+      {
+         if(!prefix.empty())
+         {
+            pos = ByteSearch::findString(text, pos, prefix);
+            if(pos < text.size() && !start_bytes.contains(text[pos]))
+            {
+               pos += 1;
+               continue;
+            }
+         }
+         else
+         {
+            /*
+               Una coincidencia que empieza en pos contiene infix a lo sumo
+               infix_offset bytes más adelante, así que la próxima aparición
+               de infix acota desde dónde vale la pena probar.
+            */
+            if(!infix.empty() && (!has_infix_pos || infix_pos < pos))
+            {
+               infix_pos = ByteSearch::findString(text, pos, infix);
+               has_infix_pos = true;
+               if(infix_pos >= text.size())
+               {
+                  return false;
+               }
+
+               if(required_literal.infix_offset != LiteralInfo::NO_LIMIT && infix_pos - pos > required_literal.infix_offset)
+               {
+                  pos = infix_pos - required_literal.infix_offset;
+               }
+            }
+
+            pos = start_bytes.find(text, pos);
+            if(!infix.empty() && pos < text.size() && pos > infix_pos)
+            {
+               continue;
+            }
+         }
+
+         if(pos >= text.size())
+         {
+            return false;
+         }
+
+         uint64_t end_pos = pos;
+         if(checkAndAdvance(text, end_pos, text.size(), true) && end_pos > pos)
+         {
+            product = ParseProduct(pos, end_pos);
+            return true;
+         }
+
+         pos += 1;
+      }
+   }
+
+   uint64_t LanguageExpression::findAll(string_view text, const FactoryFunction& func, bool overlapping, uint64_t init_pos) const
+   {
+      uint64_t count = 0;
+
+      ParseProduct product;
+      uint64_t pos = init_pos;
+      while(find(text, product, pos))
       {
-         delete command;
+         func(product);
+         count += 1;
+
+         pos = overlapping ? product.begin() + 1 : product.end();
       }
+
+      return count;
+   }
+
+   void LanguageExpression::clear()
+   {
+      compiled = getEmptyCompiled();
    }
 
    string LanguageExpression::toString() const
    {
       string result;
 
-      for(uint32_t i = 0; i < command_sequence.size(); ++i)
+      for(auto command : compiled->command_sequence)
       {
-         result += command_sequence[i]->toString();
+         result += command->toString();
       }
 
       return result;
    }
 
-   bool LanguageExpression::checkCommands(const vector<Command*>& commands, const string& text, uint32_t& pos, uint32_t last_pos)
+   bool LanguageExpression::checkCommands(const CommandList& commands, string_view text, uint64_t& pos, uint64_t last_pos)
    {
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       for(uint32_t i = 0; i < commands.size(); ++i)
       {
          if(!commands[i]->check(text, current_pos, last_pos))
@@ -656,274 +891,732 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::createCommand(Command*& command, const string& text, uint32_t& pos, uint32_t last_pos)
+   void LanguageExpression::callFactoryFunction(const FactoryFunction& func, const ParseProduct& product)
    {
-      uint32_t command_begin = pos;
-
-      if(text[pos] == '-' || text[pos] == '_')
+      if(deferred_factory_calls != nullptr)
       {
-         CommandArgs args;
-         return COMMAND_CREATORS.at(text.substr(pos++, 1))(command, args, command_scope);
+         deferred_factory_calls->push_back({ &func, product });
       }
+      else func(product);
+   }
 
-      while(true)
+   bool LanguageExpression::isEnd(string_view text, uint64_t pos, uint64_t last_pos)
+   {
+      if(pos >= text.size() || pos >= last_pos)
       {
-         if(!(pos < last_pos) || !(pos < text.size()))
-         {
-            return false;
-         }
-
-         if(text[pos] == '(')
-         {
-            break;
-         }
-
-         ++pos;
+         UTF8Analyzer::setEndReached();
+         return true;
       }
+      return false;
+   }
 
-      string command_name = text.substr(command_begin, pos - command_begin);
-      ++pos;
-
-      auto found = COMMAND_CREATORS.find(command_name);
-      if(found == COMMAND_CREATORS.end())
-      {
-         return false;
-      }
+   bool LanguageExpression::getRegularBody(const CommandList& commands, RegularMatcher::Atom& atom)
+   {
+      return commands.size() == 1 && commands[0]->getRegularAtom(atom);
+   }
 
-      CommandArgs args;
-      if(!getCommandArgs(args, text, pos, last_pos))
+   bool LanguageExpression::getLiteralCode(const string& literal, uint32_t& char_code)
+   {
+      int char_count = 0;
+      if(!UTF8Analyzer::countNextChar(literal, char_count, 0) || uint32_t(char_count) != literal.size())
       {
          return false;
       }
 
-      if(!found->second(command, args, command_scope))
+      if(!UTF8Analyzer::getCharCode(literal, 0, char_code))
       {
          return false;
       }
 
-      return true;
+      /*
+         Solo se aceptan las codificaciones canónicas, que son las únicas
+         que el autómata compara byte a byte.
+      */
+      return UTF8Analyzer::getChar(char_code) == literal;
    }
 
-   bool LanguageExpression::getCommandArgs(CommandArgs& args, const string& expression, uint32_t& pos, uint32_t last_pos)
+   void LanguageExpression::compileCommands(const CommandList& commands, CommandProgram& program)
    {
-      if(pos >= last_pos || pos >= expression.size())
+      for(auto command : commands)
       {
-         return false;
+         command->compile(program);
       }
+   }
 
-      while(true)
+   void LanguageExpression::createSequenceFirstSet(const CommandList& commands, FirstSet& sequence_set)
+   {
+      sequence_set = FirstSet();
+      sequence_set.nullable = true;
+
+      for(auto command : commands)
       {
-         TextToken token;
-         if(!UTF8Tokenizator::getToken(expression, pos, token).ok())
+         if(!command->isShared())
          {
-            return false;
+            command->createFirstSet();
          }
-         pos += token.value.size();
-
-         switch(token.type)
-         {
-         case TextToken::SPACE:
-            continue;
-            break;
-
-         case TextToken::SYMBOL:
-            if(token.value == ")")
-            {
-               return true;
-            }
 
-            if(token.value != "\"")
-            {
-               return false;
-            }
+         sequence_set.appendSet(command->getFirstSet());
+      }
+   }
 
-            if(!getStringToken(args, expression, pos, last_pos))
-            {
-               return false;
-            }
+   bool LanguageExpression::canStart(const ByteSearch& bytes, string_view text, uint64_t pos, uint64_t last_pos)
+   {
+      return pos >= text.size() || pos >= last_pos || bytes.contains(text[pos]);
+   }
 
-            break;
+   void LanguageExpression::compileFirstBytes(const ByteSearch& bytes, CommandProgram& program)
+   {
+      if(bytes.size() < 256)
+      {
+         program.addBytes(bytes);
+      }
+   }
 
-         case TextToken::WORD:
-            if(token.value == "true" || token.value == "false")
-            {
-               args.push_back({ CommandToken::BOOLEAN, token.value, token.char_count });
-               break;
-            }
+   void LanguageExpression::getSequenceLiteral(const CommandList& commands, LiteralInfo& info)
+   {
+      info = LiteralInfo("");
+      for(auto command : commands)
+      {
+         LiteralInfo next;
+         command->getLiteralInfo(next);
+         appendLiteral(info, next);
+      }
+   }
 
-            pos -= token.value.size();
+   void LanguageExpression::appendLiteral(LiteralInfo& info, const LiteralInfo& next)
+   {
+      const uint64_t NO_LIMIT = LiteralInfo::NO_LIMIT;
 
-            if(!getCommandSequenceToken(args, expression, pos, last_pos))
-            {
-               return false;
-            }
+      auto add = [NO_LIMIT](uint64_t a, uint64_t b) -> uint64_t
+      {
+         return a == NO_LIMIT || b == NO_LIMIT || b > NO_LIMIT - a ? NO_LIMIT : a + b;
+      };
 
-            break;
+      LiteralInfo result;
+      result.exact = info.exact && next.exact;
+      result.prefix = info.exact ? info.prefix + next.prefix : info.prefix;
+      result.suffix = next.exact ? info.suffix + next.suffix : next.suffix;
+      result.max_length = add(info.max_length, next.max_length);
+
+      /*
+         Entre los textos requeridos se elige el más largo y, si empatan, el
+         que tiene un desplazamiento conocido más chico.
+      */
+      auto consider = [&result](const string& value, uint64_t offset)
+      {
+         if(value.size() > result.infix.size() || (value.size() == result.infix.size() && offset < result.infix_offset))
+         {
+            result.infix = value;
+            result.infix_offset = offset;
+         }
+      };
+
+      result.infix_offset = NO_LIMIT;
+      consider(result.prefix, 0);
+      consider(info.infix, info.infix_offset);
+      consider(next.infix, add(info.max_length, next.infix_offset));
+      consider(info.suffix + next.prefix, info.max_length == NO_LIMIT ? NO_LIMIT : info.max_length - info.suffix.size());
+      if(result.max_length != NO_LIMIT)
+      {
+         consider(result.suffix, result.max_length - result.suffix.size());
+      }
+
+      info = move(result);
+   }
+
+   void LanguageExpression::Compiled::createCommandProgram()
+   {
+      command_program = new CommandProgram();
+
+      for(uint32_t i = 0; i < command_sequence.size(); ++i)
+      {
+         command_sequence[i]->compile(*command_program);
+
+         /*
+            El salto de EXP() no avanza, así que jumpAndCheck puede continuar
+            el programa justo después del primer comando.
+         */
+         if(i == 0 && dynamic_cast<const EXPCommand*>(command_sequence[0]) != nullptr)
+         {
+            jump_entry = command_program->size();
+         }
+      }
+
+      command_program->addInstruction(CommandProgram::MATCH);
+   }
+
+   void LanguageExpression::Compiled::createFirstSet()
+   {
+      createSequenceFirstSet(command_sequence, first_set);
+
+      first_bytes.clear();
+      first_set.getBytes(first_bytes);
+   }
+
+   void LanguageExpression::Compiled::createRegularMatcher()
+   {
+      RegularMatcher::Program program;
+      for(auto command : command_sequence)
+      {
+         if(!command->getRegularItems(program))
+         {
+            return;
+         }
+      }
+
+      regular_matcher = new RegularMatcher(move(program));
+   }
+
+   void LanguageExpression::Compiled::createStartBytes()
+   {
+      /*
+         Una coincidencia nunca empieza en un byte de continuación ni en uno
+         que no esté en el conjunto inicial. Si la expresión es regular, el
+         autómata dice exactamente con qué bytes puede empezar.
+      */
+      start_bytes.clear();
+      start_bytes.addRange(0x00, 0x7F);
+      start_bytes.addRange(0xC0, 0xFF);
+
+      for(uint32_t byte = 0; byte < 256; ++byte)
+      {
+         if(!start_bytes.contains(byte))
+         {
+            continue;
+         }
+
+         if(!first_bytes.contains(byte) || (regular_matcher != nullptr && !regular_matcher->canStart(byte)))
+         {
+            start_bytes.remove(byte);
+         }
+      }
+   }
+
+   void LanguageExpression::Compiled::createRequiredLiteral(bool calls_expressions)
+   {
+      /*
+         Saltear intentos cambiaría qué funciones de fábrica de las
+         expresiones llamadas con EXP() se ejecutan.
+      */
+      if(calls_expressions)
+      {
+         required_literal = LiteralInfo();
+         return;
+      }
+
+      getSequenceLiteral(command_sequence, required_literal);
+   }
+
+   LanguageExpression::Compiled::Compiled() :
+      regular_matcher(nullptr),
+      command_program(nullptr),
+      jump_entry(0),
+      first_set(FirstSet::unknown())
+   {
+      first_bytes.addRange(0x00, 0xFF);
+      createStartBytes();
+   }
+
+   LanguageExpression::Compiled::~Compiled()
+   {
+      delete regular_matcher;
+      delete command_program;
+   }
+
+   const shared_ptr<const LanguageExpression::Compiled>& LanguageExpression::getEmptyCompiled()
+   {
+      static const shared_ptr<const Compiled> empty(new Compiled());
+      return empty;
+   }
 
-         case TextToken::NUMBER:
-            args.push_back({ CommandToken::NUMBER, token.value, token.char_count });
+   bool LanguageExpression::matchCommands(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      /*
+         Algunos comandos ignoran last_pos mientras avanzan, por lo que el
+         autómata solo se usa cuando el límite es el final del texto.
+      */
+      if(compiled->regular_matcher != nullptr && last_pos >= text.size())
+      {
+         uint64_t end_pos;
+         switch(compiled->regular_matcher->match(text, pos, last_pos, end_pos))
+         {
+         case RegularMatcher::SUCCESS:
+            pos = end_pos;
+            return true;
+
+         case RegularMatcher::FAILURE:
+            return false;
+
+         case RegularMatcher::UNDECIDED:
             break;
          }
+      }
 
-         if(pos >= expression.size() || pos >= last_pos)
+      if(compiled->command_program != nullptr)
+      {
+         return compiled->command_program->run(text, pos, last_pos);
+      }
+
+      for(auto command : compiled->command_sequence)
+      {
+         if(!command->check(text, pos, last_pos))
          {
             return false;
          }
+      }
+
+      return true;
+   }
+
+   uint32_t LanguageExpression::getErrorPos() const
+   {
+      return error_pos;
+   }
 
-         if(expression[pos] == ',')
+   bool LanguageExpression::createCommand(Command*& command, string_view text, uint32_t& pos, CommandScope& scope)
+   {
+      uint32_t command_begin = pos;
+
+      if(pos < text.size() && (text[pos] == '-' || text[pos] == '_'))
+      {
+         ++pos;
+      }
+      else
+      {
+         while(pos < text.size() && isLetter(text[pos]))
          {
             ++pos;
-            continue;
          }
+      }
 
-         if(expression[pos] == ')')
+      string_view name = text.substr(command_begin, pos - command_begin);
+
+      CommandCreator creator;
+      if(pos == command_begin || !findCommandCreator(name, creator))
+      {
+         error_pos = command_begin;
+         return false;
+      }
+
+      CommandArgs args;
+      if(text[command_begin] != '-' && text[command_begin] != '_')
+      {
+         if(pos >= text.size() || text[pos] != '(')
          {
-            ++pos;
-            break;
+            error_pos = pos;
+            return false;
+         }
+
+         ++pos;
+         if(!getCommandArgs(args, text, pos, scope))
+         {
+            return false;
          }
+      }
+
+      /*
+         Un comando compartido se crea en el arena del registro y no llama
+         a otras expresiones.
+      */
+      bool created;
+      string key;
+      if(scope.registry != nullptr && getCommandKey(name, args, key))
+      {
+         created = scope.registry->getCommand(key, command, [&](CommandArena& arena) -> bool {
+            CommandScope shared_scope = { {}, &arena, scope.registry };
+            return creator(command, args, shared_scope);
+         });
+      }
+      else created = creator(command, args, scope);
 
+      if(!created)
+      {
+         error_pos = command_begin;
          return false;
       }
 
       return true;
    }
 
-   bool LanguageExpression::getStringToken(CommandArgs& args, const string& expression, uint32_t& pos, uint32_t last_pos)
+   bool LanguageExpression::createSequence(vector<Command*>& sequence, string_view text, uint32_t& pos, CommandScope& scope)
    {
-      CommandToken command_token;
-      command_token.type = CommandToken::STRING;
-      command_token.char_count = 0;
+      while(pos < text.size() && text[pos] != ',' && text[pos] != ')')
+      {
+         Command* command;
+         if(!createCommand(command, text, pos, scope))
+         {
+            return false;
+         }
 
-      bool active_escape = false;
+         sequence.push_back(command);
+      }
+
+      return true;
+   }
+
+   bool LanguageExpression::getCommandArgs(CommandArgs& args, string_view text, uint32_t& pos, CommandScope& scope)
+   {
       while(true)
       {
-         if(pos >= expression.size() || pos >= last_pos)
+         while(pos < text.size() && isBlank(text[pos]))
          {
-            return false;
+            ++pos;
          }
 
-         TextToken token;
-         if(!UTF8Tokenizator::getToken(expression, pos, token).ok())
+         if(pos >= text.size())
          {
+            error_pos = pos;
             return false;
          }
-         pos += token.value.size();
 
-         if(token.type == TextToken::SYMBOL)
+         char c = text[pos];
+         if(c == ')')
+         {
+            ++pos;
+            return true;
+         }
+
+         args.emplace_back();
+         CommandToken& token = args.back();
+
+         if(c == '"')
          {
-            if(token.value == "\"")
+            ++pos;
+            if(!getStringToken(token, text, pos))
             {
-               if(active_escape)
-               {
-                  active_escape = false;
-               }
-               else
+               return false;
+            }
+         }
+         else if(isDigit(c))
+         {
+            /*
+               Dígitos con a lo sumo un punto.
+            */
+            uint32_t begin = pos;
+            bool added_point = false;
+            ++pos;
+            while(pos < text.size() && (isDigit(text[pos]) || (text[pos] == '.' && !added_point)))
+            {
+               added_point = added_point || text[pos] == '.';
+               ++pos;
+            }
+
+            token.type = CommandToken::NUMBER;
+            token.value = text.substr(begin, pos - begin);
+            token.char_count = pos - begin;
+         }
+         else
+         {
+            uint32_t begin = pos;
+            while(pos < text.size() && isLetter(text[pos]))
+            {
+               ++pos;
+            }
+
+            string_view word = text.substr(begin, pos - begin);
+            token.type = CommandToken::COMMAND_SEQUENCE;
+
+            if(word == "true" || word == "false")
+            {
+               token.type = CommandToken::BOOLEAN;
+               token.value = word;
+               token.char_count = word.size();
+            }
+            else if(!word.empty() && (pos >= text.size() || text[pos] != '('))
+            {
+               /*
+                  Una palabra que no empieza un comando es un valor hasta la
+                  próxima coma o paréntesis, como en STR(abc).
+               */
+               while(pos < text.size() && text[pos] != ',' && text[pos] != ')')
                {
-                  break;
+                  ++pos;
                }
+
+               token.value = text.substr(begin, pos - begin);
+               token.char_count = pos - begin;
             }
-            else if(token.value == "\\")
+            else
             {
-               if(active_escape)
+               pos = begin;
+               if(!createSequence(token.sequence, text, pos, scope))
                {
-                  active_escape = false;
+                  return false;
                }
-               else
+
+               if(token.sequence.empty())
                {
-                  active_escape = true;
-                  continue;
+                  error_pos = pos;
+                  return false;
                }
+
+               /*
+                  Los comandos numéricos leen el texto de cualquier argumento.
+               */
+               token.value = text.substr(begin, pos - begin);
+               token.char_count = pos - begin;
             }
          }
-         else if(active_escape)
+
+         if(pos >= text.size())
          {
+            error_pos = pos;
             return false;
          }
 
-         command_token.value += token.value;
-         command_token.char_count += token.char_count;
-      }
+         if(text[pos] == ',')
+         {
+            ++pos;
+            continue;
+         }
 
-      args.push_back(command_token);
+         if(text[pos] == ')')
+         {
+            ++pos;
+            return true;
+         }
 
-      return true;
+         error_pos = pos;
+         return false;
+      }
    }
 
-   bool LanguageExpression::getCommandSequenceToken(CommandArgs& args, const string& expression, uint32_t& pos, uint32_t last_pos)
+   bool LanguageExpression::getStringToken(CommandToken& token, string_view text, uint32_t& pos)
    {
-      CommandToken command_token;
-      command_token.type = CommandToken::COMMAND_SEQUENCE;
-      command_token.char_count = 0;
+      token.type = CommandToken::STRING;
+      token.char_count = 0;
 
-      uint32_t deep = 0;
-      bool finished = false;
-      uint32_t init_pos = pos;
-      
-      while(!finished)
+      /*
+         Después de una barra, el escape sigue pendiente hasta la próxima
+         comilla o barra, y no puede haber letras, dígitos ni espacios.
+      */
+      bool active_escape = false;
+      while(true)
       {
-         if(pos >= last_pos || pos >= expression.size())
+         if(pos >= text.size())
          {
+            error_pos = pos;
             return false;
          }
 
-         TextToken token;
-         if(!UTF8Tokenizator::getToken(expression, pos, token).ok())
+         int char_count = 0;
+         if(!UTF8Analyzer::countNextChar(text, char_count, pos))
          {
+            error_pos = pos;
             return false;
          }
 
-         pos += token.char_count;
-
-         switch(token.type)
+         char c = text[pos];
+         if(char_count == 1)
          {
-         case TextToken::SYMBOL:
-            if(token.value == "(")
+            if(c == '"' || c == '\\')
             {
-               deep += 1;
-               continue;
-            }
-            else if(token.value == ")")
-            {
-               if(deep == 0)
+               if(!active_escape)
                {
-                  finished = true;
-                  break;
+                  ++pos;
+                  if(c == '"')
+                  {
+                     return true;
+                  }
+
+                  active_escape = true;
+                  continue;
                }
-               deep -= 1;
+
+               active_escape = false;
             }
-            else if(token.value == ",")
+            else if(active_escape && (isBlank(c) || isDigit(c) || isLetter(c)))
             {
-               if(deep == 0)
-               {
-                  finished = true;
-                  break;
-               }
+               error_pos = pos;
+               return false;
             }
-            continue;
-            break;
+         }
 
-         default:
-            continue;
+         token.value.append(text.substr(pos, char_count));
+         token.char_count += 1;
+         pos += char_count;
+      }
+   }
+
+   bool LanguageExpression::findCommandCreator(string_view name, CommandCreator& creator)
+   {
+      static constexpr CommandSlots SLOTS = createCommandSlots(COMMAND_CREATORS);
+      static_assert(SLOTS.perfect, "Dos nombres de comandos tienen el mismo hash");
+
+      uint8_t slot = SLOTS.entries[hashCommandName(name)];
+      if(slot == 0 || COMMAND_CREATORS[slot - 1].name != name)
+      {
+         return false;
+      }
+
+      creator = COMMAND_CREATORS[slot - 1].creator;
+      return true;
+   }
+
+   bool LanguageExpression::getCommandKey(string_view name, const CommandArgs& args, string& key)
+   {
+      /*
+         EXP() depende de las expresiones con que se crea la expresión, y
+         su conjunto inicial, de cuándo se crea.
+      */
+      if(name == "EXP")
+      {
+         return false;
+      }
+
+      key.clear();
+      appendKeyPart(key, name.data(), name.size());
+
+      /*
+         Algunos comandos leen el texto de los argumentos que son
+         secuencias, así que también forma parte de la clave.
+      */
+      for(auto& arg : args)
+      {
+         key += char(arg.type);
+         appendKeyPart(key, arg.value.data(), arg.value.size());
+
+         for(auto command : arg.sequence)
+         {
+            if(!command->isShared())
+            {
+               return false;
+            }
          }
+
+         appendKeyPart(key, arg.sequence.data(), arg.sequence.size() * sizeof(Command*));
       }
 
-      pos -= 1;
-      command_token.value = expression.substr(init_pos, pos - init_pos);
-      command_token.char_count = pos - init_pos;
-      args.push_back(command_token);
+      return true;
+   }
+
+   bool LanguageExpression::takeSequence(CommandToken& token, CommandScope& scope, CommandList& sequence)
+   {
+      if(token.sequence.empty())
+      {
+         return false;
+      }
 
+      sequence = scope.arena->createArray(token.sequence);
       return true;
    }
 
+
    /*
       class LanguageExpression::Command
    */
-   LanguageExpression::Command::Command()
+   LanguageExpression::Command::Command() :
+      first_set(FirstSet::unknown()),
+      shared(false)
    {}
 
    LanguageExpression::Command::~Command()
    {}
 
+   bool LanguageExpression::Command::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      return false;
+   }
+
+   bool LanguageExpression::Command::getRegularItems(RegularMatcher::Program& program) const
+   {
+      RegularMatcher::Atom atom;
+      if(!getRegularAtom(atom))
+      {
+         return false;
+      }
+
+      program.push_back(RegularMatcher::Item(RegularMatcher::Item::ATOM, atom));
+      return true;
+   }
+
+   void LanguageExpression::Command::compile(CommandProgram& program) const
+   {
+      RegularMatcher::Atom atom;
+      if(getRegularAtom(atom) && atom.type == RegularMatcher::Atom::CLASS)
+      {
+         program.addClass(atom);
+         return;
+      }
+
+      program.addCommand(this);
+   }
+
+   void LanguageExpression::Command::getLiteralInfo(LiteralInfo& info) const
+   {
+      info = LiteralInfo();
+
+      RegularMatcher::Atom atom;
+      if(getRegularAtom(atom) && atom.type == RegularMatcher::Atom::CLASS)
+      {
+         info.max_length = LiteralInfo::MAX_CHAR_SIZE;
+      }
+   }
+
+   void LanguageExpression::Command::createFirstSet()
+   {
+      first_set = FirstSet();
+
+      RegularMatcher::Atom atom;
+      if(getRegularAtom(atom))
+      {
+         if(atom.type == RegularMatcher::Atom::NUMBER)
+         {
+            first_set.chars.addRange('0', '9');
+            return;
+         }
+
+         first_set.chars = atom.chars;
+         first_set.value_chars = atom.value_chars;
+         return;
+      }
+
+      /*
+         Si no es un carácter, se usa el primero del texto con el que
+         empieza toda coincidencia.
+      */
+      LiteralInfo info;
+      getLiteralInfo(info);
+      if(info.prefix.size() == 0)
+      {
+         if(!info.exact)
+         {
+            first_set = FirstSet::unknown();
+         }
+         else first_set.nullable = true;
+         return;
+      }
+
+      int char_count = 0;
+      uint32_t char_code;
+      if(!UTF8Analyzer::countNextChar(info.prefix, char_count, 0) || !UTF8Analyzer::getCharCode(info.prefix, 0, char_code))
+      {
+         first_set = FirstSet::unknown();
+         return;
+      }
+
+      if(UTF8Analyzer::isCanonical(info.prefix, 0, char_count))
+      {
+         first_set.chars.addRange(char_code, char_code);
+      }
+      else first_set.value_chars.addRange(char_code, char_code);
+   }
+
+   const LanguageExpression::FirstSet& LanguageExpression::Command::getFirstSet() const
+   {
+      return first_set;
+   }
+
+   bool LanguageExpression::Command::isShared() const
+   {
+      return shared;
+   }
+
+   bool LanguageExpression::Command::isRepetition() const
+   {
+      return false;
+   }
+
    /*
       class LanguageExpression::UCHARCommand
    */
@@ -941,14 +1634,9 @@ namespace dnc
    LanguageExpression::UCHARCommand::~UCHARCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::UCHARCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar(unique_char) };
-   }
-
-   bool LanguageExpression::UCHARCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::UCHARCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -969,14 +1657,26 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::UCHARCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::UCHARCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      return false;
+   }
+
+   bool LanguageExpression::UCHARCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      return false;
+      uint32_t char_code;
+      if(!getLiteralCode(unique_char, char_code))
+      {
+         return false;
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, CharClass(char_code, char_code), false);
+      return true;
    }
 
-   LanguageExpression::Command* LanguageExpression::UCHARCommand::copy() const
+   void LanguageExpression::UCHARCommand::getLiteralInfo(LiteralInfo& info) const
    {
-      return new UCHARCommand(unique_char);
+      info = LiteralInfo(unique_char);
    }
 
    string LanguageExpression::UCHARCommand::toString() const
@@ -993,14 +1693,9 @@ namespace dnc
    LanguageExpression::CHARCommand::~CHARCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::CHARCommand::getInitExpressionChar() const
+   bool LanguageExpression::CHARCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      return { ExpressionChar() };
-   }
-
-   bool LanguageExpression::CHARCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
-   {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1020,14 +1715,15 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::CHARCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::CHARCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::CHARCommand::copy() const
+   bool LanguageExpression::CHARCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      return new CHARCommand();
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, CharClass(0, RegularMatcher::MAX_CHAR_CODE), true);
+      return true;
    }
 
    string LanguageExpression::CHARCommand::toString() const
@@ -1052,23 +1748,17 @@ namespace dnc
    LanguageExpression::STRCommand::~STRCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::STRCommand::getInitExpressionChar() const
-   {
-      int char_count = 0;
-      UTF8Analyzer::countNextChar(value, char_count, 0);
-      return { ExpressionChar(value.substr(0, char_count)) };
-   }
-
-   bool LanguageExpression::STRCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::STRCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      uint32_t final_pos = pos + value.size();
+      uint64_t final_pos = pos + value.size();
       if(final_pos > text.size() || final_pos > last_pos)
       {
+         UTF8Analyzer::setEndReached();
          return false;
       }
 
@@ -1081,14 +1771,62 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::STRCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::STRCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::STRCommand::copy() const
+   bool LanguageExpression::STRCommand::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      uint32_t char_code;
+      if(!getLiteralCode(value, char_code))
+      {
+         return false;
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, CharClass(char_code, char_code), false);
+      return true;
+   }
+
+   bool LanguageExpression::STRCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      if(value.size() == 0)
+      {
+         program.push_back(RegularMatcher::Item());
+         return true;
+      }
+
+      uint32_t pos = 0;
+      while(pos < value.size())
+      {
+         int char_count = 0;
+         if(!UTF8Analyzer::countNextChar(value, char_count, pos))
+         {
+            return false;
+         }
+
+         uint32_t char_code;
+         if(!getLiteralCode(value.substr(pos, char_count), char_code))
+         {
+            return false;
+         }
+
+         program.push_back(RegularMatcher::Item(RegularMatcher::Item::ATOM,
+            RegularMatcher::Atom(RegularMatcher::Atom::CLASS, CharClass(char_code, char_code), false)));
+         pos += char_count;
+      }
+
+      return true;
+   }
+
+   void LanguageExpression::STRCommand::getLiteralInfo(LiteralInfo& info) const
    {
-      return new STRCommand(value);
+      info = LiteralInfo(value);
+   }
+
+   void LanguageExpression::STRCommand::compile(CommandProgram& program) const
+   {
+      program.addString(value);
    }
 
    string LanguageExpression::STRCommand::toString() const
@@ -1115,19 +1853,9 @@ namespace dnc
    LanguageExpression::NUMCommand::~NUMCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::NUMCommand::getInitExpressionChar() const
-   {
-      string init_chars;
-      for(uint32_t i = min_num; i <= max_num; ++i)
-      {
-         init_chars += dnc::toString(i);
-      }
-      return { ExpressionChar(init_chars) };
-   }
-
-   bool LanguageExpression::NUMCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::NUMCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1143,8 +1871,7 @@ namespace dnc
          return false;
       }
 
-      string str_num = token.value.substr(0, 1);
-      double num = atof(str_num.c_str());
+      double num = text[pos] - '0';
 
       pos += 1;
 
@@ -1156,14 +1883,21 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::NUMCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::NUMCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::NUMCommand::copy() const
+   bool LanguageExpression::NUMCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      return new NUMCommand(min_num, max_num);
+      CharClass digits;
+      if(min_num <= 9 && min_num <= max_num)
+      {
+         digits.addRange('0' + min_num, '0' + (max_num < 9 ? max_num : 9));
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, digits, false);
+      return true;
    }
 
    string LanguageExpression::NUMCommand::toString() const
@@ -1198,14 +1932,9 @@ namespace dnc
    LanguageExpression::NUMTCommand::~NUMTCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::NUMTCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar("0123456789") };
-   }
-
-   bool LanguageExpression::NUMTCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::NUMTCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1238,19 +1967,37 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::NUMTCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::NUMTCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::NUMTCommand::copy() const
+   bool LanguageExpression::NUMTCommand::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      if(use_range)
+      {
+         return false;
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::NUMBER, CharClass('0', '9'), false);
+      return true;
+   }
+
+   void LanguageExpression::NUMTCommand::createFirstSet()
+   {
+      first_set = FirstSet();
+      first_set.chars.addRange('0', '9');
+   }
+
+   void LanguageExpression::NUMTCommand::compile(CommandProgram& program) const
    {
       if(use_range)
       {
-         return new NUMTCommand(min_num, max_num);
+         program.addCommand(this);
+         return;
       }
 
-      return new NUMTCommand();
+      program.addInstruction(CommandProgram::NUMBER);
    }
 
    string LanguageExpression::NUMTCommand::toString() const
@@ -1290,14 +2037,9 @@ namespace dnc
    LanguageExpression::INUMTCommand::~INUMTCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::INUMTCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar("0123456789") };
-   }
-
-   bool LanguageExpression::INUMTCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::INUMTCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1334,19 +2076,15 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::INUMTCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::INUMTCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::INUMTCommand::copy() const
+   void LanguageExpression::INUMTCommand::createFirstSet()
    {
-      if(use_range)
-      {
-         return new INUMTCommand(min_num, max_num);
-      }
-
-      return new INUMTCommand();
+      first_set = FirstSet();
+      first_set.chars.addRange('0', '9');
    }
 
    string LanguageExpression::INUMTCommand::toString() const
@@ -1373,14 +2111,9 @@ namespace dnc
    LanguageExpression::BLANKCommand::~BLANKCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::BLANKCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar(" \n\t\r") };
-   }
-
-   bool LanguageExpression::BLANKCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::BLANKCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1407,14 +2140,23 @@ namespace dnc
       return found;
    }
 
-   bool LanguageExpression::BLANKCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::BLANKCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::BLANKCommand::copy() const
+   bool LanguageExpression::BLANKCommand::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      CharClass blank_chars(0, 32);
+      blank_chars.addRange(127, 127);
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::RUN, blank_chars, false);
+      return true;
+   }
+
+   void LanguageExpression::BLANKCommand::compile(CommandProgram& program) const
    {
-      return new BLANKCommand();
+      program.addInstruction(CommandProgram::BLANK);
    }
 
    string LanguageExpression::BLANKCommand::toString() const
@@ -1431,14 +2173,9 @@ namespace dnc
    LanguageExpression::OPTBLANKCommand::~OPTBLANKCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::OPTBLANKCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar(" \n\r\t") };
-   }
-
-   bool LanguageExpression::OPTBLANKCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::OPTBLANKCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -1462,14 +2199,31 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::OPTBLANKCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::OPTBLANKCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::OPTBLANKCommand::copy() const
+   bool LanguageExpression::OPTBLANKCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      RegularMatcher::Atom atom;
+      BLANKCommand().getRegularAtom(atom);
+
+      program.push_back(RegularMatcher::Item(RegularMatcher::Item::OPT, atom));
+      return true;
+   }
+
+   void LanguageExpression::OPTBLANKCommand::createFirstSet()
+   {
+      first_set = FirstSet();
+      first_set.chars.addRange(0, 32);
+      first_set.chars.addRange(127, 127);
+      first_set.nullable = true;
+   }
+
+   void LanguageExpression::OPTBLANKCommand::compile(CommandProgram& program) const
    {
-      return new OPTBLANKCommand();
+      program.addInstruction(CommandProgram::OPTBLANK);
    }
 
    string LanguageExpression::OPTBLANKCommand::toString() const
@@ -1483,45 +2237,26 @@ namespace dnc
    LanguageExpression::REPCommand::REPCommand()
    {}
 
-   LanguageExpression::REPCommand::REPCommand(const vector<Command*>& commands, uint32_t min, uint32_t max) :
+   LanguageExpression::REPCommand::REPCommand(const CommandList& commands, uint32_t min, uint32_t max) :
       commands(commands),
       min(min),
       max(max)
    {}
 
    LanguageExpression::REPCommand::~REPCommand()
-   {
-      for(auto c : commands)
-      {
-         delete c;
-      }
-   }
-
-   LanguageExpression::InitExpressionChar LanguageExpression::REPCommand::getInitExpressionChar() const
-   {
-      if(commands.size() > 0)
-      {
-         return commands[0]->getInitExpressionChar();
-      }
-      return { ExpressionChar("") };
-   }
+   {}
 
-   bool LanguageExpression::REPCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::REPCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
       uint32_t repeated = 0;
-      uint32_t current_pos = pos;
-      while(true)
+      uint64_t current_pos = pos;
+      while(checkRepetition(text, current_pos, last_pos))
       {
-         if(!checkCommands(commands, text, current_pos, last_pos))
-         {
-            break;
-         }
-
          repeated += 1;
       }
 
@@ -1535,7 +2270,7 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::REPCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::REPCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       if(commands.size() == 0)
       {
@@ -1547,18 +2282,18 @@ namespace dnc
          return false;
       }
 
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
       uint32_t repeated = 0;
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
 
       bool toRepeat = true;
       for(uint32_t i = 1; i < commands.size(); ++i)
       {
-         uint32_t sub_current_pos = current_pos;
+         uint64_t sub_current_pos = current_pos;
          if(!commands[i]->check(text, sub_current_pos, last_pos))
          {
             toRepeat = false;
@@ -1568,13 +2303,8 @@ namespace dnc
       }
       if(toRepeat) repeated = 1;
 
-      while(toRepeat)
+      while(toRepeat && checkRepetition(text, current_pos, last_pos))
       {
-         if(!checkCommands(commands, text, current_pos, last_pos))
-         {
-            break;
-         }
-
          repeated += 1;
       }
 
@@ -1588,15 +2318,93 @@ namespace dnc
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::REPCommand::copy() const
+   bool LanguageExpression::REPCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      vector<Command*> copied_commands;
-      for(auto c : commands)
+      if(min != 1 || max != uint32_t(-1) || !getRegularBody(commands, atom) || atom.type != RegularMatcher::Atom::CLASS)
+      {
+         return false;
+      }
+
+      atom.type = RegularMatcher::Atom::RUN;
+      return true;
+   }
+
+   bool LanguageExpression::REPCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      if(min > RegularMatcher::MAX_COUNT || (max > RegularMatcher::MAX_COUNT && max != uint32_t(-1)))
+      {
+         return false;
+      }
+
+      RegularMatcher::Item item;
+      item.type = RegularMatcher::Item::REP;
+      item.min = min;
+      item.max = max;
+      if(!getRegularBody(commands, item.first))
+      {
+         return false;
+      }
+
+      program.push_back(item);
+      return true;
+   }
+
+   void LanguageExpression::REPCommand::getLiteralInfo(LiteralInfo& info) const
+   {
+      LiteralInfo body;
+      getSequenceLiteral(commands, body);
+
+      info = LiteralInfo();
+      if(min > 0)
+      {
+         info.prefix = body.prefix;
+         info.suffix = body.suffix;
+         info.infix = body.infix;
+         info.infix_offset = body.infix_offset;
+      }
+
+      if(body.max_length != LiteralInfo::NO_LIMIT && (body.max_length == 0 || max <= LiteralInfo::NO_LIMIT / body.max_length))
+      {
+         info.max_length = body.max_length * max;
+      }
+   }
+
+   void LanguageExpression::REPCommand::createFirstSet()
+   {
+      createSequenceFirstSet(commands, first_set);
+      if(min == 0)
       {
-         copied_commands.push_back(c->copy());
+         first_set.nullable = true;
       }
+   }
+
+   void LanguageExpression::REPCommand::compile(CommandProgram& program) const
+   {
+      /*
+         GUARD
+         COUNTER_PUSH
+         loop: CATCH end
+         <commands>
+         COMMIT next
+         next: PROGRESS end
+         COUNTER_INC
+         JUMP loop
+         end: COUNTER_POP min,max
+      */
+      program.addInstruction(CommandProgram::GUARD);
+      program.addInstruction(CommandProgram::COUNTER_PUSH);
 
-      return new REPCommand(copied_commands, min, max);
+      uint32_t loop = program.addInstruction(CommandProgram::CATCH);
+      compileCommands(commands, program);
+      uint32_t commit = program.addInstruction(CommandProgram::COMMIT);
+      program.setTarget(commit, program.size());
+      uint32_t progress = program.addInstruction(CommandProgram::PROGRESS);
+      program.addInstruction(CommandProgram::COUNTER_INC);
+      program.addInstruction(CommandProgram::JUMP, loop);
+
+      program.setTarget(loop, program.size());
+      program.setTarget(progress, program.size());
+      program.addInstruction(CommandProgram::COUNTER_POP, min, max);
    }
 
    string LanguageExpression::REPCommand::toString() const
@@ -1621,48 +2429,56 @@ namespace dnc
       return result;
    }
 
+   bool LanguageExpression::REPCommand::isRepetition() const
+   {
+      return true;
+   }
+
+   bool LanguageExpression::REPCommand::checkRepetition(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      uint64_t current_pos = pos;
+      if(!checkCommands(commands, text, current_pos, last_pos) || current_pos == pos)
+      {
+         return false;
+      }
+
+      pos = current_pos;
+      return true;
+   }
+
+   bool LanguageExpression::REPCommand::isRepeatCountValid(uint32_t repeated) const
+   {
+      return repeated >= min && repeated <= max;
+   }
+
    /*
       class LanguageExpression::REPIFCommand
    */
    LanguageExpression::REPIFCommand::REPIFCommand()
    {}
 
-   LanguageExpression::REPIFCommand::REPIFCommand(const vector<Command*>& sequence, const vector<Command*>& condition, bool ignore, uint32_t min, uint32_t max) :
+   LanguageExpression::REPIFCommand::REPIFCommand(const CommandList& sequence, const CommandList& condition, bool ignore, uint32_t min, uint32_t max) :
       REPCommand(sequence, min, max),
       condition(condition),
       ignore(ignore)
    {}
 
    LanguageExpression::REPIFCommand::~REPIFCommand()
-   {
-      for(auto c : condition)
-      {
-         delete c;
-      }
-   }
-
-   LanguageExpression::InitExpressionChar LanguageExpression::REPIFCommand::getInitExpressionChar() const
-   {
-      if(commands.size() > 0)
-      {
-         return commands[0]->getInitExpressionChar();
-      }
-
-      return { ExpressionChar("") };
-   }
+   {}
 
-   bool LanguageExpression::REPIFCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::REPIFCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
       uint32_t repeated = 0;
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       bool condition_found = false;
       while(true)
       {
+         uint64_t repetition_pos = current_pos;
          if(!checkCommands(commands, text, current_pos, last_pos))
          {
             if(condition_found && !ignore)
@@ -1674,7 +2490,7 @@ namespace dnc
 
          repeated += 1;
 
-         if(!checkCommands(condition, text, current_pos, last_pos))
+         if(!checkCondition(text, current_pos, last_pos, repetition_pos))
          {
             break;
          }
@@ -1691,7 +2507,7 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::REPIFCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::REPIFCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       if(commands.size() == 0)
       {
@@ -1703,19 +2519,19 @@ namespace dnc
          return false;
       }
 
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
       uint32_t repeated = 0;
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       bool condition_found = false;
 
       bool toRepeat = true;
       for(uint32_t i = 1; i < commands.size(); ++i)
       {
-         uint32_t sub_current_pos = current_pos;
+         uint64_t sub_current_pos = current_pos;
          if(!commands[i]->check(text, sub_current_pos, last_pos))
          {
             toRepeat = false;
@@ -1734,6 +2550,7 @@ namespace dnc
 
       while(toRepeat)
       {
+         uint64_t repetition_pos = current_pos;
          if(!checkCommands(commands, text, current_pos, last_pos))
          {
             if(condition_found && !ignore)
@@ -1745,7 +2562,7 @@ namespace dnc
 
          repeated += 1;
 
-         if(!checkCommands(condition, text, current_pos, last_pos))
+         if(!checkCondition(text, current_pos, last_pos, repetition_pos))
          {
             break;
          }
@@ -1762,21 +2579,106 @@ namespace dnc
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::REPIFCommand::copy() const
+   bool LanguageExpression::REPIFCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      vector<Command*> copied_sequence;
-      for(auto c : commands)
+      return false;
+   }
+
+   bool LanguageExpression::REPIFCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      if(min > RegularMatcher::MAX_COUNT || (max > RegularMatcher::MAX_COUNT && max != uint32_t(-1)))
       {
-         copied_sequence.push_back(c->copy());
+         return false;
       }
 
-      vector<Command*> copied_condition;
-      for(auto c : condition)
+      RegularMatcher::Item item;
+      item.type = RegularMatcher::Item::REPIF;
+      item.min = min;
+      item.max = max;
+      item.ignore = ignore;
+      if(!getRegularBody(commands, item.first) || !getRegularBody(condition, item.second))
+      {
+         return false;
+      }
+
+      program.push_back(item);
+      return true;
+   }
+
+   void LanguageExpression::REPIFCommand::getLiteralInfo(LiteralInfo& info) const
+   {
+      /*
+         Con ignore, la coincidencia puede terminar en la condición, así que
+         solo se conoce el comienzo.
+      */
+      LiteralInfo body;
+      getSequenceLiteral(commands, body);
+
+      info = LiteralInfo();
+      if(min > 0)
+      {
+         info.prefix = body.prefix;
+         info.infix = body.infix;
+         info.infix_offset = body.infix_offset;
+      }
+   }
+
+   void LanguageExpression::REPIFCommand::createFirstSet()
+   {
+      REPCommand::createFirstSet();
+
+      /*
+         La condición no cambia el conjunto, pero sus comandos también
+         necesitan el suyo.
+      */
+      FirstSet condition_set;
+      createSequenceFirstSet(condition, condition_set);
+   }
+
+   void LanguageExpression::REPIFCommand::compile(CommandProgram& program) const
+   {
+      /*
+         GUARD
+         COUNTER_PUSH
+         loop: CATCH sequence_failed
+         <commands>
+         COMMIT next
+         next: COUNTER_INC
+         CATCH end
+         <condition>
+         COMMIT found
+         found: PROGRESS end
+         COUNTER_MARK
+         JUMP loop
+         sequence_failed: COUNTER_TEST (si no se ignora)
+         end: COUNTER_POP min,max
+      */
+      program.addInstruction(CommandProgram::GUARD);
+      program.addInstruction(CommandProgram::COUNTER_PUSH);
+
+      uint32_t loop = program.addInstruction(CommandProgram::CATCH);
+      compileCommands(commands, program);
+      uint32_t commit = program.addInstruction(CommandProgram::COMMIT);
+      program.setTarget(commit, program.size());
+      program.addInstruction(CommandProgram::COUNTER_INC);
+
+      uint32_t condition_catch = program.addInstruction(CommandProgram::CATCH);
+      compileCommands(condition, program);
+      commit = program.addInstruction(CommandProgram::COMMIT);
+      program.setTarget(commit, program.size());
+      uint32_t progress = program.addInstruction(CommandProgram::PROGRESS);
+      program.addInstruction(CommandProgram::COUNTER_MARK);
+      program.addInstruction(CommandProgram::JUMP, loop);
+
+      program.setTarget(loop, program.size());
+      if(!ignore)
       {
-         copied_condition.push_back(c->copy());
+         program.addInstruction(CommandProgram::COUNTER_TEST);
       }
 
-      return new REPIFCommand(copied_sequence, condition, ignore, min, max);
+      program.setTarget(condition_catch, program.size());
+      program.setTarget(progress, program.size());
+      program.addInstruction(CommandProgram::COUNTER_POP, min, max);
    }
 
    string LanguageExpression::REPIFCommand::toString() const
@@ -1815,78 +2717,83 @@ namespace dnc
       return result;
    }
 
-   /*
-      class LanguageExpression::ORCommand
-   */
-   LanguageExpression::ORCommand::ORCommand()
-   {}
-
-   LanguageExpression::ORCommand::ORCommand(const vector<Command*>& first, const vector<Command*>& second) :
-      first(first),
-      second(second)
-   {}
+   bool LanguageExpression::REPIFCommand::isRepetition() const
+   {
+      return false;
+   }
 
-   LanguageExpression::ORCommand::~ORCommand()
+   bool LanguageExpression::REPIFCommand::checkCondition(string_view text, uint64_t& pos, uint64_t last_pos, uint64_t repetition_pos) const
    {
-      for(auto c : first)
+      uint64_t current_pos = pos;
+      if(!checkCommands(condition, text, current_pos, last_pos) || current_pos == repetition_pos)
       {
-         delete c;
+         return false;
       }
 
-      for(auto c : second)
-      {
-         delete c;
-      }
+      pos = current_pos;
+      return true;
    }
 
-   LanguageExpression::InitExpressionChar LanguageExpression::ORCommand::getInitExpressionChar() const
+   /*
+      class LanguageExpression::ORCommand
+   */
+   LanguageExpression::ORCommand::ORCommand()
    {
-      auto first_expression_char = first[0]->getInitExpressionChar();
-      auto second_expression_char = second[0]->getInitExpressionChar();
-
-      InitExpressionChar init_exp_char;
-      for(auto& exp_char : first_expression_char)
-      {
-         init_exp_char.push_back(move(exp_char));
-      }
-      for(auto& exp_char : second_expression_char)
-      {
-         init_exp_char.push_back(move(exp_char));
-      }
+      first_bytes.addRange(0x00, 0xFF);
+      second_bytes.addRange(0x00, 0xFF);
+   }
 
-      return init_exp_char;
+   LanguageExpression::ORCommand::ORCommand(const CommandList& first, const CommandList& second) :
+      first(first),
+      second(second)
+   {
+      first_bytes.addRange(0x00, 0xFF);
+      second_bytes.addRange(0x00, 0xFF);
    }
 
-   bool LanguageExpression::ORCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   LanguageExpression::ORCommand::~ORCommand()
+   {}
+
+   bool LanguageExpression::ORCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      if(checkCommands(first, text, pos, last_pos))
+      /*
+         Solo se prueban las alternativas que pueden empezar con el byte
+         siguiente.
+      */
+      if(canStart(first_bytes, text, pos, last_pos) && checkCommands(first, text, pos, last_pos))
       {
-         checkCommands(second, text, pos, last_pos);
+         if(canStart(second_bytes, text, pos, last_pos))
+         {
+            checkCommands(second, text, pos, last_pos);
+         }
          return true;
       }
 
-      if(checkCommands(second, text, pos, last_pos))
+      if(canStart(second_bytes, text, pos, last_pos) && checkCommands(second, text, pos, last_pos))
       {
-         checkCommands(first, text, pos, last_pos);
+         if(canStart(first_bytes, text, pos, last_pos))
+         {
+            checkCommands(first, text, pos, last_pos);
+         }
          return true;
       }
 
       return false;
    }
 
-   bool LanguageExpression::ORCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::ORCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       if(first[0]->jumpAndCheck(text, current_pos, last_pos))
       {
          bool completed = true;
@@ -1929,9 +2836,82 @@ namespace dnc
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::ORCommand::copy() const
+   bool LanguageExpression::ORCommand::getRegularItems(RegularMatcher::Program& program) const
    {
-      return new ORCommand(first, second);
+      RegularMatcher::Item item;
+      item.type = RegularMatcher::Item::OR;
+      if(!getRegularBody(first, item.first) || !getRegularBody(second, item.second))
+      {
+         return false;
+      }
+
+      program.push_back(item);
+      return true;
+   }
+
+   void LanguageExpression::ORCommand::createFirstSet()
+   {
+      FirstSet second_set;
+      createSequenceFirstSet(first, first_set);
+      createSequenceFirstSet(second, second_set);
+
+      first_bytes.clear();
+      first_set.getBytes(first_bytes);
+      second_bytes.clear();
+      second_set.getBytes(second_bytes);
+
+      first_set.addSet(second_set);
+   }
+
+   void LanguageExpression::ORCommand::compile(CommandProgram& program) const
+   {
+      /*
+         GUARD
+         CATCH second_first
+         BYTES first
+         <first>
+         COMMIT first_second
+         first_second: CATCH end
+         BYTES second
+         <second>
+         COMMIT end
+         second_first: BYTES second
+         <second>
+         CATCH end
+         BYTES first
+         <first>
+         COMMIT end
+         end:
+
+         Los BYTES se omiten si la alternativa puede empezar con cualquier
+         byte.
+      */
+      program.addInstruction(CommandProgram::GUARD);
+
+      uint32_t first_catch = program.addInstruction(CommandProgram::CATCH);
+      compileFirstBytes(first_bytes, program);
+      compileCommands(first, program);
+      uint32_t first_commit = program.addInstruction(CommandProgram::COMMIT);
+      program.setTarget(first_commit, program.size());
+
+      uint32_t second_catch = program.addInstruction(CommandProgram::CATCH);
+      compileFirstBytes(second_bytes, program);
+      compileCommands(second, program);
+      uint32_t second_commit = program.addInstruction(CommandProgram::COMMIT);
+
+      program.setTarget(first_catch, program.size());
+      compileFirstBytes(second_bytes, program);
+      compileCommands(second, program);
+      uint32_t last_catch = program.addInstruction(CommandProgram::CATCH);
+      compileFirstBytes(first_bytes, program);
+      compileCommands(first, program);
+      uint32_t last_commit = program.addInstruction(CommandProgram::COMMIT);
+
+      uint32_t end = program.size();
+      program.setTarget(second_catch, end);
+      program.setTarget(second_commit, end);
+      program.setTarget(last_catch, end);
+      program.setTarget(last_commit, end);
    }
 
    string LanguageExpression::ORCommand::toString() const
@@ -1955,57 +2935,35 @@ namespace dnc
       class LanguageExpression::XORCommand
    */
    LanguageExpression::XORCommand::XORCommand()
-   {}
+   {
+      first_bytes.addRange(0x00, 0xFF);
+      second_bytes.addRange(0x00, 0xFF);
+   }
 
-   LanguageExpression::XORCommand::XORCommand(const vector<Command*>& first, const vector<Command*>& second) :
+   LanguageExpression::XORCommand::XORCommand(const CommandList& first, const CommandList& second) :
       first(first),
       second(second)
-   {}
-
-   LanguageExpression::XORCommand::~XORCommand()
    {
-      for(auto c : first)
-      {
-         delete c;
-      }
-
-      for(auto c : second)
-      {
-         delete c;
-      }
+      first_bytes.addRange(0x00, 0xFF);
+      second_bytes.addRange(0x00, 0xFF);
    }
 
-   LanguageExpression::InitExpressionChar LanguageExpression::XORCommand::getInitExpressionChar() const
-   {
-      auto first_expression_char = first[0]->getInitExpressionChar();
-      auto second_expression_char = second[0]->getInitExpressionChar();
-
-      InitExpressionChar init_exp_char;
-      for(auto& exp_char : first_expression_char)
-      {
-         init_exp_char.push_back(move(exp_char));
-      }
-      for(auto& exp_char : second_expression_char)
-      {
-         init_exp_char.push_back(move(exp_char));
-      }
-
-      return init_exp_char;
-   }
+   LanguageExpression::XORCommand::~XORCommand()
+   {}
 
-   bool LanguageExpression::XORCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::XORCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      if(checkCommands(first, text, pos, last_pos))
+      if(canStart(first_bytes, text, pos, last_pos) && checkCommands(first, text, pos, last_pos))
       {
          return true;
       }
 
-      if(checkCommands(second, text, pos, last_pos))
+      if(canStart(second_bytes, text, pos, last_pos) && checkCommands(second, text, pos, last_pos))
       {
          return true;
       }
@@ -2013,14 +2971,14 @@ namespace dnc
       return false;
    }
 
-   bool LanguageExpression::XORCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::XORCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       if(first[0]->jumpAndCheck(text, current_pos, last_pos))
       {
          bool completed = true;
@@ -2061,9 +3019,82 @@ namespace dnc
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::XORCommand::copy() const
+   bool LanguageExpression::XORCommand::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      RegularMatcher::Atom second_atom;
+      if(!getRegularBody(first, atom) || atom.type != RegularMatcher::Atom::CLASS ||
+         !getRegularBody(second, second_atom) || second_atom.type != RegularMatcher::Atom::CLASS)
+      {
+         return false;
+      }
+
+      atom.addClass(second_atom);
+      return true;
+   }
+
+   bool LanguageExpression::XORCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      if(Command::getRegularItems(program))
+      {
+         return true;
+      }
+
+      RegularMatcher::Item item;
+      item.type = RegularMatcher::Item::XOR;
+      if(!getRegularBody(first, item.first) || !getRegularBody(second, item.second))
+      {
+         return false;
+      }
+
+      program.push_back(item);
+      return true;
+   }
+
+   void LanguageExpression::XORCommand::createFirstSet()
+   {
+      FirstSet second_set;
+      createSequenceFirstSet(first, first_set);
+      createSequenceFirstSet(second, second_set);
+
+      first_bytes.clear();
+      first_set.getBytes(first_bytes);
+      second_bytes.clear();
+      second_set.getBytes(second_bytes);
+
+      first_set.addSet(second_set);
+   }
+
+   void LanguageExpression::XORCommand::compile(CommandProgram& program) const
    {
-      return new XORCommand(first, second);
+      RegularMatcher::Atom atom;
+      if(getRegularAtom(atom))
+      {
+         program.addClass(atom);
+         return;
+      }
+
+      /*
+         GUARD
+         CATCH second
+         BYTES first
+         <first>
+         COMMIT end
+         second: BYTES second
+         <second>
+         end:
+      */
+      program.addInstruction(CommandProgram::GUARD);
+
+      uint32_t first_catch = program.addInstruction(CommandProgram::CATCH);
+      compileFirstBytes(first_bytes, program);
+      compileCommands(first, program);
+      uint32_t first_commit = program.addInstruction(CommandProgram::COMMIT);
+
+      program.setTarget(first_catch, program.size());
+      compileFirstBytes(second_bytes, program);
+      compileCommands(second, program);
+
+      program.setTarget(first_commit, program.size());
    }
 
    string LanguageExpression::XORCommand::toString() const
@@ -2089,26 +3120,16 @@ namespace dnc
    LanguageExpression::OPTCommand::OPTCommand()
    {}
 
-   LanguageExpression::OPTCommand::OPTCommand(const vector<Command*>& sequence) :
+   LanguageExpression::OPTCommand::OPTCommand(const CommandList& sequence) :
       sequence(sequence)
    {}
 
    LanguageExpression::OPTCommand::~OPTCommand()
-   {
-      for(auto c : sequence)
-      {
-         delete c;
-      }
-   }
-
-   LanguageExpression::InitExpressionChar LanguageExpression::OPTCommand::getInitExpressionChar() const
-   {
-      return sequence[0]->getInitExpressionChar();
-   }
+   {}
 
-   bool LanguageExpression::OPTCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::OPTCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -2121,14 +3142,14 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::OPTCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::OPTCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       if(sequence.size() == 0)
       {
          return false;
       }
 
-      uint32_t current_pos = pos;
+      uint64_t current_pos = pos;
       if(!sequence[0]->jumpAndCheck(text, current_pos, last_pos))
       {
          return false;
@@ -2148,9 +3169,51 @@ namespace dnc
       return true;
    }
 
-   LanguageExpression::Command* LanguageExpression::OPTCommand::copy() const
+   bool LanguageExpression::OPTCommand::getRegularItems(RegularMatcher::Program& program) const
+   {
+      RegularMatcher::Item item;
+      item.type = RegularMatcher::Item::OPT;
+      if(!getRegularBody(sequence, item.first))
+      {
+         return false;
+      }
+
+      program.push_back(item);
+      return true;
+   }
+
+   void LanguageExpression::OPTCommand::getLiteralInfo(LiteralInfo& info) const
+   {
+      LiteralInfo body;
+      getSequenceLiteral(sequence, body);
+
+      info = LiteralInfo();
+      info.max_length = body.max_length;
+   }
+
+   void LanguageExpression::OPTCommand::createFirstSet()
    {
-      return new OPTCommand(sequence);
+      createSequenceFirstSet(sequence, first_set);
+      first_set.nullable = true;
+   }
+
+   void LanguageExpression::OPTCommand::compile(CommandProgram& program) const
+   {
+      /*
+         GUARD
+         CATCH end
+         <sequence>
+         COMMIT end
+         end:
+      */
+      program.addInstruction(CommandProgram::GUARD);
+
+      uint32_t sequence_catch = program.addInstruction(CommandProgram::CATCH);
+      compileCommands(sequence, program);
+      uint32_t sequence_commit = program.addInstruction(CommandProgram::COMMIT);
+
+      program.setTarget(sequence_catch, program.size());
+      program.setTarget(sequence_commit, program.size());
    }
 
    string LanguageExpression::OPTCommand::toString() const
@@ -2177,29 +3240,43 @@ namespace dnc
    LanguageExpression::EXPCommand::~EXPCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::EXPCommand::getInitExpressionChar() const
+   const LanguageExpression* LanguageExpression::EXPCommand::getExpression() const
    {
-      return expression->getInitExpressionChar();
+      return expression;
    }
 
-   bool LanguageExpression::EXPCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::EXPCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      return expression->checkAndAdvance(text, pos, last_pos, true);
+      return ParseMemo::check(expression, text, pos, last_pos);
    }
 
-   bool LanguageExpression::EXPCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::EXPCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return true;
    }
 
-   LanguageExpression::Command* LanguageExpression::EXPCommand::copy() const
+   void LanguageExpression::EXPCommand::createFirstSet()
+   {
+      /*
+         El conjunto de una expresión cambia si se vuelve a crear, así que
+         solo se copia el de una gramática, que no depende de sus reglas.
+         El de una expresión se revisa al llamarla.
+      */
+      if(dynamic_cast<const Grammar*>(expression) != nullptr)
+      {
+         first_set = expression->getFirstSet();
+      }
+      else first_set = FirstSet::unknown();
+   }
+
+   void LanguageExpression::EXPCommand::compile(CommandProgram& program) const
    {
-      return new EXPCommand(expression);
+      program.addCall(expression);
    }
 
    string LanguageExpression::EXPCommand::toString() const
@@ -2221,16 +3298,6 @@ namespace dnc
    LanguageExpression::RANGECommand::~RANGECommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::RANGECommand::getInitExpressionChar() const
-   {
-      string init_chars;
-      for(uint32_t i = min; i < max; ++i)
-      {
-         init_chars += UTF8Analyzer::getChar(i);
-      }
-      return { ExpressionChar(init_chars) };
-   }
-
    uint32_t LanguageExpression::RANGECommand::getMin() const
    {
       return min;
@@ -2241,9 +3308,9 @@ namespace dnc
       return max;
    }
 
-   bool LanguageExpression::RANGECommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::RANGECommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -2270,14 +3337,21 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::RANGECommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::RANGECommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::RANGECommand::copy() const
+   bool LanguageExpression::RANGECommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      return new RANGECommand(min, max);
+      CharClass chars;
+      if(min <= RegularMatcher::MAX_CHAR_CODE)
+      {
+         chars.addRange(min, max < RegularMatcher::MAX_CHAR_CODE ? max : RegularMatcher::MAX_CHAR_CODE);
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, chars, true);
+      return true;
    }
 
    string LanguageExpression::RANGECommand::toString() const
@@ -2298,14 +3372,9 @@ namespace dnc
    LanguageExpression::LETTERCommand::~LETTERCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::LETTERCommand::getInitExpressionChar() const
-   {
-      return { ExpressionChar("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ") };
-   }
-
-   bool LanguageExpression::LETTERCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::LETTERCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
@@ -2332,14 +3401,18 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::LETTERCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::LETTERCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::LETTERCommand::copy() const
+   bool LanguageExpression::LETTERCommand::getRegularAtom(RegularMatcher::Atom& atom) const
    {
-      return new LETTERCommand();
+      CharClass letters(min0, max0);
+      letters.addRange(min1, max1);
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, letters, true);
+      return true;
    }
 
    string LanguageExpression::LETTERCommand::toString() const
@@ -2370,10 +3443,12 @@ namespace dnc
    /*
       class LanguageExpression::SETCommand
    */
-   LanguageExpression::SETCommand::SETCommand()
+   LanguageExpression::SETCommand::SETCommand() :
+      low_codes{ 0, 0, 0, 0 }
    {}
 
-   LanguageExpression::SETCommand::SETCommand(const string& chars)
+   LanguageExpression::SETCommand::SETCommand(const string& chars) :
+      low_codes{ 0, 0, 0, 0 }
    {
       addFromString(chars);
    }
@@ -2381,23 +3456,12 @@ namespace dnc
    LanguageExpression::SETCommand::~SETCommand()
    {}
 
-   LanguageExpression::InitExpressionChar LanguageExpression::SETCommand::getInitExpressionChar() const
-   {
-      string init_chars;
-      for(auto& val : value)
-      {
-         init_chars += val;
-      }
-      return { ExpressionChar(init_chars) };
-   }
-
    void LanguageExpression::SETCommand::addElement(uint32_t min, uint32_t max)
    {
-      for(uint32_t i = min; i < max; ++i)
-      {
-         value.insert(UTF8Analyzer::getChar(i));
-      }
-      value.insert(UTF8Analyzer::getChar(max));
+      /*
+         Si max es menor que min, solo se agrega max.
+      */
+      addCodes(min <= max ? min : max, max);
 
       ranges.push_back({ min, max });
    }
@@ -2406,21 +3470,66 @@ namespace dnc
    {
       this->chars += chars;
 
-      uint32_t pos = 0;
+      uint64_t pos = 0;
       int char_count = 0;
 
       while(pos < chars.size())
       {
-         UTF8Analyzer::countNextChar(chars, char_count, pos);
-         value.insert(chars.substr(pos, char_count));
+         uint32_t char_code;
+         if(!UTF8Analyzer::countNextChar(chars, char_count, pos) || !UTF8Analyzer::getCharCode(chars, pos, char_code))
+         {
+            pos += 1;
+            continue;
+         }
+
+         if(UTF8Analyzer::isCanonical(chars, pos, char_count))
+         {
+            addCodes(char_code, char_code);
+         }
+         else raw_elements.insert(chars.substr(pos, char_count));
+
          pos += char_count;
       }
    }
 
-   bool LanguageExpression::SETCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   void LanguageExpression::SETCommand::addCodes(uint32_t min, uint32_t max)
    {
-      if(pos >= text.size() || pos >= last_pos)
+      /*
+         getChar no puede codificar los códigos mayores, así que nunca
+         coincidían con el texto.
+      */
+      if(max > 0x10FFFF)
+      {
+         max = 0x10FFFF;
+      }
+      if(min > max)
+      {
+         return;
+      }
+
+      elements.addRange(min, max);
+
+      for(uint32_t code = min; code <= max && code < 256; ++code)
+      {
+         low_codes[code / 64] |= uint64_t(1) << (code % 64);
+      }
+   }
+
+   bool LanguageExpression::SETCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
+   {
+      if(isEnd(text, pos, last_pos))
+      {
+         return false;
+      }
+
+      uint8_t c = text[pos];
+      if(c < 128)
       {
+         if(low_codes[c / 64] & (uint64_t(1) << (c % 64)))
+         {
+            pos += 1;
+            return true;
+         }
          return false;
       }
 
@@ -2430,7 +3539,24 @@ namespace dnc
          return false;
       }
 
-      if(value.find(text.substr(pos, char_count)) == value.end())
+      uint32_t char_code;
+      if(!UTF8Analyzer::getCharCode(text, pos, char_code))
+      {
+         return false;
+      }
+
+      bool found;
+      if(!UTF8Analyzer::isCanonical(text, pos, char_count))
+      {
+         found = raw_elements.size() > 0 && raw_elements.find(text.substr(pos, char_count)) != raw_elements.end();
+      }
+      else if(char_code < 256)
+      {
+         found = low_codes[char_code / 64] & (uint64_t(1) << (char_code % 64));
+      }
+      else found = elements.contains(char_code);
+
+      if(!found)
       {
          return false;
       }
@@ -2439,14 +3565,35 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::SETCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::SETCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::SETCommand::copy() const
+   bool LanguageExpression::SETCommand::getRegularAtom(RegularMatcher::Atom& atom) const
+   {
+      if(raw_elements.size() > 0)
+      {
+         return false;
+      }
+
+      atom = RegularMatcher::Atom(RegularMatcher::Atom::CLASS, elements, false);
+      return true;
+   }
+
+   void LanguageExpression::SETCommand::createFirstSet()
    {
-      return new SETCommand(chars);
+      first_set = FirstSet();
+      first_set.chars = elements;
+
+      for(auto& element : raw_elements)
+      {
+         uint32_t char_code;
+         if(UTF8Analyzer::getCharCode(element, 0, char_code))
+         {
+            first_set.value_chars.addRange(char_code, char_code);
+         }
+      }
    }
 
    string LanguageExpression::SETCommand::toString() const
@@ -2464,41 +3611,57 @@ namespace dnc
    /*
       class LanguageExpression::SWITCHCommand
    */
-   LanguageExpression::SWITCHCommand::SWITCHCommand()
-   {}
-
-   LanguageExpression::SWITCHCommand::~SWITCHCommand()
+   LanguageExpression::SWITCHCommand::SWITCHCommand() :
+      SWITCHCommand(CommandList())
    {}
 
-   void LanguageExpression::SWITCHCommand::addCommand(Command* command)
+   LanguageExpression::SWITCHCommand::SWITCHCommand(const CommandList& commands) :
+      commands(commands),
+      dispatch(commands.begin(), commands.end()),
+      only_classes(true)
    {
-      commands.insert(command);
-   }
+      /*
+         Hasta que se calcule el conjunto inicial, cada comando se prueba con
+         cualquier byte.
+      */
+      for(auto& span : dispatch_spans)
+      {
+         span.begin = 0;
+         span.end = commands.size();
+      }
 
-   LanguageExpression::InitExpressionChar LanguageExpression::SWITCHCommand::getInitExpressionChar() const
-   {
-      InitExpressionChar init_exp_char;
       for(auto command : commands)
       {
-         auto exp_char = command->getInitExpressionChar();
-         for(auto& c : exp_char)
+         RegularMatcher::Atom atom;
+         if(command->getRegularAtom(atom) && atom.type == RegularMatcher::Atom::CLASS)
          {
-            init_exp_char.push_back(move(c));
+            class_atom.addClass(atom);
          }
+         else only_classes = false;
       }
-      return init_exp_char;
    }
 
-   bool LanguageExpression::SWITCHCommand::check(const string& text, uint32_t& pos, uint32_t last_pos) const
+   LanguageExpression::SWITCHCommand::~SWITCHCommand()
+   {}
+
+   bool LanguageExpression::SWITCHCommand::check(string_view text, uint64_t& pos, uint64_t last_pos) const
    {
-      if(pos >= text.size() || pos >= last_pos)
+      if(isEnd(text, pos, last_pos))
       {
          return false;
       }
 
-      for(auto command : commands)
+      if(only_classes)
+      {
+         class_atom.checkChar(text, pos);
+         return true;
+      }
+
+      auto& span = dispatch_spans[uint8_t(text[pos])];
+      for(uint32_t i = span.begin; i < span.end; ++i)
       {
-         uint32_t current_pos = pos;
+         auto command = dispatch[i];
+         uint64_t current_pos = pos;
          if(command->check(text, current_pos, last_pos))
          {
             pos = current_pos;
@@ -2509,19 +3672,69 @@ namespace dnc
       return true;
    }
 
-   bool LanguageExpression::SWITCHCommand::jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const
+   bool LanguageExpression::SWITCHCommand::jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const
    {
       return false;
    }
 
-   LanguageExpression::Command* LanguageExpression::SWITCHCommand::copy() const
+   void LanguageExpression::SWITCHCommand::createFirstSet()
    {
-      auto new_command = new SWITCHCommand();
-      for(auto& command : commands)
+      /*
+         SWITCH acepta aunque ninguno de los comandos coincida.
+      */
+      first_set = FirstSet();
+      first_set.nullable = true;
+
+      vector<ByteSearch> command_bytes(commands.size());
+      for(uint32_t i = 0; i < commands.size(); ++i)
+      {
+         if(!commands[i]->isShared())
+         {
+            commands[i]->createFirstSet();
+         }
+
+         first_set.addSet(commands[i]->getFirstSet());
+         commands[i]->getFirstSet().getBytes(command_bytes[i]);
+      }
+
+      dispatch.clear();
+      for(uint32_t byte = 0; byte < 256; ++byte)
+      {
+         dispatch_spans[byte].begin = dispatch.size();
+         for(uint32_t i = 0; i < commands.size(); ++i)
+         {
+            if(command_bytes[i].contains(byte))
+            {
+               dispatch.push_back(commands[i]);
+            }
+         }
+         dispatch_spans[byte].end = dispatch.size();
+      }
+   }
+
+   void LanguageExpression::SWITCHCommand::compile(CommandProgram& program) const
+   {
+      if(!only_classes || commands.size() == 0)
       {
-         new_command->addCommand(command->copy());
+         program.addCommand(this);
+         return;
       }
-      return new_command;
+
+      /*
+         GUARD
+         CATCH end
+         CLASS
+         COMMIT end
+         end:
+      */
+      program.addInstruction(CommandProgram::GUARD);
+
+      uint32_t class_catch = program.addInstruction(CommandProgram::CATCH);
+      program.addClass(class_atom);
+      uint32_t class_commit = program.addInstruction(CommandProgram::COMMIT);
+
+      program.setTarget(class_catch, program.size());
+      program.setTarget(class_commit, program.size());
    }
 
    string LanguageExpression::SWITCHCommand::toString() const
@@ -2542,42 +3755,117 @@ namespace dnc
    }
 
    /*
-      class LanguageExpression::ExpressionChar
+      struct LanguageExpression::LiteralInfo
    */
-   LanguageExpression::ExpressionChar::ExpressionChar() :
-      type(ANY_TERMINAL),
-      value("")
+   const uint64_t LanguageExpression::LiteralInfo::NO_LIMIT = -1;
+   const uint64_t LanguageExpression::LiteralInfo::MAX_CHAR_SIZE = 4;
+
+   LanguageExpression::LiteralInfo::LiteralInfo() :
+      exact(false),
+      infix_offset(0),
+      max_length(NO_LIMIT)
    {}
 
-   LanguageExpression::ExpressionChar::ExpressionChar(const std::string& value) :
-      type(TERMINAL),
-      value(value)
+   LanguageExpression::LiteralInfo::LiteralInfo(const string& value) :
+      exact(true),
+      prefix(value),
+      suffix(value),
+      infix(value),
+      infix_offset(0),
+      max_length(value.size())
    {}
 
-   LanguageExpression::ExpressionChar::ExpressionChar(const LanguageExpression* ref) :
-      type(NONTERMINAL),
-      ref(ref)
+   /*
+      struct LanguageExpression::FirstSet
+   */
+   LanguageExpression::FirstSet::FirstSet() :
+      any(false),
+      nullable(false)
    {}
 
-   LanguageExpression::ExpressionChar::ExpressionChar(const ExpressionChar& exp_char) :
-      type(exp_char.type)
+   LanguageExpression::FirstSet LanguageExpression::FirstSet::unknown()
+   {
+      FirstSet result;
+      result.any = true;
+      result.nullable = true;
+      return result;
+   }
+
+   void LanguageExpression::FirstSet::addSet(const FirstSet& other)
+   {
+      chars.addClass(other.chars);
+      value_chars.addClass(other.value_chars);
+      for(auto ref : other.refs)
+      {
+         if(std::find(refs.begin(), refs.end(), ref) == refs.end())
+         {
+            refs.push_back(ref);
+         }
+      }
+      any = any || other.any;
+      nullable = nullable || other.nullable;
+   }
+
+   void LanguageExpression::FirstSet::appendSet(const FirstSet& next)
    {
-      switch(type)
+      if(!nullable)
       {
-      case TERMINAL:
-         value = exp_char.value;
-         break;
+         return;
+      }
 
-      case NONTERMINAL:
-         ref = exp_char.ref;
-         break;
+      nullable = false;
+      addSet(next);
+   }
 
-      case ANY_TERMINAL:
-         value = "";
-         break;
+   bool LanguageExpression::FirstSet::canStart(uint32_t char_code, bool canonical) const
+   {
+      if(any || nullable || refs.size() > 0)
+      {
+         return true;
       }
+
+      return canonical ? chars.contains(char_code) : value_chars.contains(char_code);
    }
 
-   LanguageExpression::ExpressionChar::~ExpressionChar()
-   {}
+   void LanguageExpression::FirstSet::getBytes(ByteSearch& bytes) const
+   {
+      if(any || nullable || refs.size() > 0)
+      {
+         bytes.addRange(0x00, 0xFF);
+         return;
+      }
+
+      /*
+         Una codificación no canónica puede empezar con cualquier byte que
+         no sea ASCII.
+      */
+      if(!value_chars.empty())
+      {
+         bytes.addRange(0x80, 0xFF);
+      }
+
+      /*
+         Primer byte de la codificación canónica para cada longitud: código
+         mínimo y máximo, bits del encabezado y desplazamiento.
+      */
+      static const uint32_t LEAD_BYTES[4][4] = {
+         { 0, 0x7F, 0, 0 },
+         { 0x80, 0x7FF, 0xC0, 6 },
+         { 0x800, 0xFFFF, 0xE0, 12 },
+         { 0x10000, 0x10FFFF, 0xF0, 18 }
+      };
+
+      for(auto& range : chars.getRanges())
+      {
+         for(auto& lead : LEAD_BYTES)
+         {
+            uint32_t min = range.min > lead[0] ? range.min : lead[0];
+            uint32_t max = range.max < lead[1] ? range.max : lead[1];
+            if(min <= max)
+            {
+               bytes.addRange(lead[2] | (min >> lead[3]), lead[2] | (max >> lead[3]));
+            }
+         }
+      }
+   }
 }
@@ -1,43 +1,88 @@
 #pragma once
 
 #include <vector>
-#include <map>
-#include <unordered_set>
+#include <set>
 #include <string>
+#include <string_view>
 #include <functional>
+#include <memory>
 
 #include "TextToken.hpp"
 #include "ParseProduct.hpp"
+#include "RegularMatcher.hpp"
+#include "ParseMemo.hpp"
+#include "CallStack.hpp"
+#include "CommandArena.hpp"
+#include "ByteSearch.hpp"
 
 namespace dnc
 {
+   class CommandProgram;
+   class CommandRegistry;
+
    class LanguageExpression
    {
    public:
-      struct ExpressionChar
+      /*
+         Texto que aparece en toda coincidencia de un comando. Si exact es
+         true, toda coincidencia es exactamente prefix. infix es el texto
+         requerido más largo y empieza a lo sumo infix_offset bytes después
+         del comienzo de la coincidencia.
+      */
+      struct LiteralInfo
       {
-         enum Type
-         {
-            TERMINAL,
-            NONTERMINAL,
-            ANY_TERMINAL
-         };
-
-         Type type;
-         union
-         {
-            std::string value;
-            const LanguageExpression* ref;
-         };
-
-         ExpressionChar();
-         ExpressionChar(const std::string& value);
-         ExpressionChar(const LanguageExpression* ref);
-         ExpressionChar(const ExpressionChar& exp_char);
-         ~ExpressionChar();
+         bool exact;
+         std::string prefix;
+         std::string suffix;
+         std::string infix;
+         uint64_t infix_offset;
+         uint64_t max_length;
+
+         LiteralInfo();
+         LiteralInfo(const std::string& value);
+
+         static const uint64_t NO_LIMIT;
+         static const uint64_t MAX_CHAR_SIZE;
       };
 
-      typedef std::vector<ExpressionChar> InitExpressionChar;
+      /*
+         Caracteres con los que puede empezar una coincidencia: chars por su
+         codificación canónica y value_chars por cualquier otra. refs son las
+         gramáticas que se analizan antes de leer. Si any es true, puede
+         empezar con cualquier carácter; si nullable es true, puede
+         coincidir sin avanzar.
+      */
+      struct FirstSet
+      {
+         CharClass chars;
+         CharClass value_chars;
+         std::vector<const LanguageExpression*> refs;
+         bool any;
+         bool nullable;
+
+         /*
+            Empieza vacío y sin coincidencias vacías.
+         */
+         FirstSet();
+
+         static FirstSet unknown();
+
+         /*
+            addSet() une las dos alternativas; appendSet() agrega lo que
+            sigue en la secuencia, que solo cuenta si lo anterior puede
+            coincidir sin avanzar.
+         */
+         void addSet(const FirstSet& other);
+         void appendSet(const FirstSet& next);
+
+         bool canStart(uint32_t char_code, bool canonical) const;
+
+         /*
+            Agrega los bytes con los que puede empezar una coincidencia. Si
+            puede no avanzar, son todos.
+         */
+         void getBytes(ByteSearch& bytes) const;
+      };
 
       class Command
       {
@@ -45,19 +90,66 @@ namespace dnc
          Command();
          virtual ~Command();
 
-         virtual bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const = 0;
-         virtual bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const = 0;
-
-         virtual InitExpressionChar getInitExpressionChar() const = 0;
+         virtual bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const = 0;
+         virtual bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const = 0;
+
+         /*
+            Describen el comando como parte de una expresión regular. Si el
+            comando no puede expresarse así, devuelven false.
+         */
+         virtual bool getRegularAtom(RegularMatcher::Atom& atom) const;
+         virtual bool getRegularItems(RegularMatcher::Program& program) const;
+
+         virtual void getLiteralInfo(LiteralInfo& info) const;
+
+         /*
+            Calcula el conjunto inicial del comando y de los que contiene.
+            Hasta entonces es desconocido.
+         */
+         virtual void createFirstSet();
+         const FirstSet& getFirstSet() const;
+
+         /*
+            Los comandos de un CommandRegistry ya tienen su conjunto inicial
+            y no cambian más.
+         */
+         bool isShared() const;
+
+         /*
+            Indica si el comando es un REP() que puede revisarse de a una
+            repetición.
+         */
+         virtual bool isRepetition() const;
+
+         /*
+            Agrega al programa las instrucciones equivalentes al comando.
+         */
+         virtual void compile(CommandProgram& program) const;
 
-         virtual Command* copy() const = 0;
          virtual std::string toString() const = 0;
+
+      protected:
+         FirstSet first_set;
+
+      private:
+         friend class CommandRegistry;
+
+         bool shared;
       };
 
+      /*
+         Secuencia de comandos ubicada en el arena de la expresión.
+      */
+      typedef CommandArena::Array<Command*> CommandList;
+
       struct CommandScope
       {
-         std::function<bool(Command*&, const std::string&, uint32_t&, uint32_t)> createCommand;
          std::vector<const LanguageExpression*> expressions;
+         /*
+            Arena donde create() ubica los comandos que compila.
+         */
+         CommandArena* arena;
+         CommandRegistry* registry;
       };
 
       struct CommandToken
@@ -73,6 +165,12 @@ namespace dnc
          Type type;
          std::string value;
          uint32_t char_count;
+         /*
+            Comandos ya creados de un argumento COMMAND_SEQUENCE; está
+            vacío si el argumento es una palabra suelta. value tiene el
+            texto en ambos casos.
+         */
+         std::vector<Command*> sequence;
       };
 
       typedef std::vector<CommandToken> CommandArgs;
@@ -81,27 +179,113 @@ namespace dnc
 
       LanguageExpression();
       LanguageExpression(const std::string& text, const std::vector<const LanguageExpression*>& expressions = std::vector<const LanguageExpression*>());
+      /*
+         Las copias comparten los comandos compilados, que no cambian, así
+         que copiar o mover una expresión no depende de su tamaño. create()
+         y clear() solo afectan a la expresión sobre la que se llaman.
+      */
+      LanguageExpression(const LanguageExpression& other);
+      LanguageExpression(LanguageExpression&& other);
       virtual ~LanguageExpression();
 
-      virtual InitExpressionChar getInitExpressionChar() const;
+      LanguageExpression& operator=(const LanguageExpression& other);
+      LanguageExpression& operator=(LanguageExpression&& other);
+
+      /*
+         Conjunto inicial de la expresión, calculado al crearla. Las
+         expresiones llamadas con EXP() deben crearse antes que las que las
+         llaman.
+      */
+      virtual const FirstSet& getFirstSet() const;
+
+      /*
+         Describe lo que analiza jumpAndCheck() cuando el primer comando es
+         EXP(): blank indica si sigue "-" o "_", y next_set es el conjunto
+         inicial de lo que viene después de esos espacios. Si el primer
+         comando es otro, devuelve false.
+      */
+      enum JumpBlank
+      {
+         NO_BLANK,
+         OPTIONAL_BLANK,
+         REQUIRED_BLANK
+      };
+
+      bool getJumpSet(FirstSet& next_set, JumpBlank& blank) const;
+
+      /*
+         Indica si una coincidencia puede empezar en pos. Al final del texto
+         devuelve true, para que el análisis lo marque como alcanzado.
+      */
+      bool canStartAt(std::string_view text, uint64_t pos, uint64_t last_pos) const;
 
       void setFactoryFunction(const FactoryFunction& func);
       void resetFactoryFunction();
 
+      /*
+         La tabla no pasa a ser propiedad de la expresión.
+      */
+      void setParseMemo(ParseMemo* memo);
+      void resetParseMemo();
+      ParseMemo* getParseMemo() const;
+
+      /*
+         Con una pila, los análisis de la expresión anidan sus llamadas en
+         ella. Tampoco pasa a ser propiedad de la expresión.
+      */
+      void setCallStack(CallStack* stack);
+      void resetCallStack();
+      CallStack* getCallStack() const;
+
+      /*
+         Con un registro, create() toma de él los comandos que ya creó otra
+         expresión con el mismo registro. Tampoco pasa a ser propiedad de la
+         expresión, y debe existir mientras exista lo que se creó con él.
+      */
+      void setCommandRegistry(CommandRegistry* registry);
+      void resetCommandRegistry();
+      CommandRegistry* getCommandRegistry() const;
+
+      /*
+         Compila el texto en una sola pasada. Si falla, la expresión no
+         cambia y getErrorPos() indica la posición del texto donde se
+         detectó el error.
+      */
       bool create(const std::string& text, uint32_t init_pos = 0, const std::vector<const LanguageExpression*>& expressions = std::vector<const LanguageExpression*>());
       bool create(const std::string& text, uint32_t init_pos, uint32_t last_pos, const std::vector<const LanguageExpression*>& expressions = std::vector<const LanguageExpression*>());
 
-      virtual bool check(const std::string& text, uint32_t init_pos = 0, bool ignore_rest = true) const;
-      virtual bool check(const std::string& text, uint32_t init_pos, uint32_t last_pos, bool ignore_rest = true) const;
-      virtual bool checkAndAdvance(const std::string& text, uint32_t& init_pos, uint32_t last_pos, bool ignore_rest) const;
+      static const uint32_t NO_ERROR_POS;
+
+      uint32_t getErrorPos() const;
 
-      virtual bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const;
+      virtual bool check(std::string_view text, uint64_t init_pos = 0, bool ignore_rest = true) const;
+      virtual bool check(std::string_view text, uint64_t init_pos, uint64_t last_pos, bool ignore_rest = true) const;
+      virtual bool checkAndAdvance(std::string_view text, uint64_t& init_pos, uint64_t last_pos, bool ignore_rest) const;
+
+      virtual bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+
+      /*
+         Buscan coincidencias de la expresión que empiecen en cualquier
+         carácter desde init_pos. Las coincidencias vacías se ignoran.
+      */
+      bool find(std::string_view text, ParseProduct& product, uint64_t init_pos = 0) const;
+      uint64_t findAll(std::string_view text, const FactoryFunction& func, bool overlapping = false, uint64_t init_pos = 0) const;
 
       void clear();
 
       std::string toString() const;
 
+   protected:
+      /*
+         Llama a func con product, o guarda la llamada si el análisis la
+         difiere.
+      */
+      static void callFactoryFunction(const FactoryFunction& func, const ParseProduct& product);
+
    private:
+      friend class StreamSession;
+      friend class GrammarProductions;
+
       class UCHARCommand : public Command
       {
       public:
@@ -110,12 +294,12 @@ namespace dnc
          UCHARCommand(std::string&& unique_char);
          ~UCHARCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
+         void getLiteralInfo(LiteralInfo& info) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -128,12 +312,11 @@ namespace dnc
          CHARCommand();
          ~CHARCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
       };
 
@@ -145,12 +328,15 @@ namespace dnc
          STRCommand(std::string&& str);
          ~STRCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+         void getLiteralInfo(LiteralInfo& info) const override;
+
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -165,12 +351,11 @@ namespace dnc
          NUMCommand(uint16_t min_num, uint16_t max_num);
          ~NUMCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -186,12 +371,15 @@ namespace dnc
          NUMTCommand(double min_num, double max_num);
          ~NUMTCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void createFirstSet() override;
+
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -208,12 +396,11 @@ namespace dnc
          INUMTCommand(uint64_t min_num, uint64_t max_num);
          ~INUMTCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void createFirstSet() override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -228,12 +415,13 @@ namespace dnc
          BLANKCommand();
          ~BLANKCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
       };
 
@@ -243,12 +431,15 @@ namespace dnc
          OPTBLANKCommand();
          ~OPTBLANKCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+
+         void createFirstSet() override;
+
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
       };
 
@@ -256,19 +447,34 @@ namespace dnc
       {
       public:
          REPCommand();
-         REPCommand(const std::vector<Command*>& commands, uint32_t min = 1, uint32_t max = -1);
+         REPCommand(const CommandList& commands, uint32_t min = 1, uint32_t max = -1);
          virtual ~REPCommand();
 
-         virtual bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         virtual bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+         void getLiteralInfo(LiteralInfo& info) const override;
+
+         virtual void createFirstSet() override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         virtual Command* copy() const override;
          virtual std::string toString() const override;
 
+         bool isRepetition() const override;
+
+         /*
+            Revisa una sola repetición a partir de pos. Devuelve false si
+            el cuerpo no coincide o coincide sin avanzar, que es donde
+            check() termina la repetición.
+         */
+         bool checkRepetition(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+         bool isRepeatCountValid(uint32_t repeated) const;
+
       protected:
-         std::vector<Command*> commands;
+         CommandList commands;
          uint32_t min;
          uint32_t max;
       };
@@ -277,79 +483,112 @@ namespace dnc
       {
       public:
          REPIFCommand();
-         REPIFCommand(const std::vector<Command*>& sequence, const std::vector<Command*>& condition, bool ignore = false, uint32_t min = 1, uint32_t max = -1);
+         REPIFCommand(const CommandList& sequence, const CommandList& condition, bool ignore = false, uint32_t min = 1, uint32_t max = -1);
          ~REPIFCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+         void getLiteralInfo(LiteralInfo& info) const override;
+
+         void createFirstSet() override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
+         bool isRepetition() const override;
+
       private:
-         std::vector<Command*> condition;
+         CommandList condition;
          bool ignore;
+
+         /*
+            La condición no cuenta si la repetición que empezó en
+            repetition_pos no avanzó con ella, porque se repetiría para
+            siempre.
+         */
+         bool checkCondition(std::string_view text, uint64_t& pos, uint64_t last_pos, uint64_t repetition_pos) const;
       };
 
       class ORCommand : public Command
       {
       public:
          ORCommand();
-         ORCommand(const std::vector<Command*>& first, const std::vector<Command*>& second);
+         ORCommand(const CommandList& first, const CommandList& second);
          ~ORCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+
+         void createFirstSet() override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
-         std::vector<Command*> first;
-         std::vector<Command*> second;
+         CommandList first;
+         CommandList second;
+         ByteSearch first_bytes;
+         ByteSearch second_bytes;
       };
 
       class XORCommand : public Command
       {
       public:
          XORCommand();
-         XORCommand(const std::vector<Command*>& first, const std::vector<Command*>& second);
+         XORCommand(const CommandList& first, const CommandList& second);
          ~XORCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         /*
+            Si las dos alternativas son de un solo carácter, el XOR es la
+            unión de sus clases.
+         */
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+
+         void createFirstSet() override;
+
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
-         std::vector<Command*> first;
-         std::vector<Command*> second;
+         CommandList first;
+         CommandList second;
+         ByteSearch first_bytes;
+         ByteSearch second_bytes;
       };
 
       class OPTCommand : public Command
       {
       public:
          OPTCommand();
-         OPTCommand(const std::vector<Command*>& sequence);
+         OPTCommand(const CommandList& sequence);
          ~OPTCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularItems(RegularMatcher::Program& program) const override;
+         void getLiteralInfo(LiteralInfo& info) const override;
+
+         void createFirstSet() override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
-         std::vector<Command*> sequence;
+         CommandList sequence;
       };
 
       class EXPCommand : public Command
@@ -359,12 +598,15 @@ namespace dnc
          EXPCommand(const LanguageExpression* expression);
          ~EXPCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         const LanguageExpression* getExpression() const;
+
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void createFirstSet() override;
+
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -381,12 +623,11 @@ namespace dnc
          uint32_t getMin() const;
          uint32_t getMax() const;
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -400,12 +641,11 @@ namespace dnc
          LETTERCommand();
          ~LETTERCommand();
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
@@ -443,54 +683,182 @@ namespace dnc
          void addElement(uint32_t min, uint32_t max);
          void addFromString(const std::string& chars);
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+
+         bool getRegularAtom(RegularMatcher::Atom& atom) const override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void createFirstSet() override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
       	std::string chars;
-         std::unordered_set<std::string> value;
          std::vector<Range> ranges;
+         /*
+            Los códigos menores a 256 se buscan en un mapa de bits y el resto
+            en los intervalos de elements. Los caracteres de chars que no
+            están codificados de forma canónica solo coinciden byte a byte.
+         */
+         uint64_t low_codes[4];
+         CharClass elements;
+         std::set<std::string, std::less<>> raw_elements;
+
+         void addCodes(uint32_t min, uint32_t max);
       };
 
       class SWITCHCommand : public Command
       {
       public:
          SWITCHCommand();
+         SWITCHCommand(const CommandList& commands);
          ~SWITCHCommand();
 
-         void addCommand(Command* command);
+         bool check(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
+         bool jumpAndCheck(std::string_view text, uint64_t& pos, uint64_t last_pos) const override;
 
-         bool check(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
-         bool jumpAndCheck(const std::string& text, uint32_t& pos, uint32_t last_pos) const override;
+         void createFirstSet() override;
 
-         InitExpressionChar getInitExpressionChar() const override;
+         void compile(CommandProgram& program) const override;
 
-         Command* copy() const override;
          std::string toString() const override;
 
       private:
-         std::unordered_set<Command*> commands;
+         struct Span
+         {
+            uint32_t begin;
+            uint32_t end;
+         };
+
+         CommandList commands;
+         /*
+            Para cada byte, el tramo de dispatch con los comandos que pueden
+            empezar con él, en el orden en que se declararon.
+         */
+         std::vector<Command*> dispatch;
+         Span dispatch_spans[256];
+         /*
+            Unión de las clases de los comandos, válida mientras todos sean
+            de un solo carácter.
+         */
+         RegularMatcher::Atom class_atom;
+         bool only_classes;
       };
 
-      typedef std::function<bool(Command*&, CommandArgs&, CommandScope&)> CommandCreator;
+      typedef bool (*CommandCreator)(Command*&, CommandArgs&, CommandScope&);
 
-      static const std::map<std::string, CommandCreator> COMMAND_CREATORS;
+      struct CommandCreatorEntry
+      {
+         std::string_view name;
+         CommandCreator creator;
+      };
 
-      std::vector<Command*> command_sequence;
-      CommandScope command_scope;
-      bool has_factory_function;
-      FactoryFunction factory_function;
+      /*
+         Se buscan con un hash perfecto del nombre (ver findCommandCreator()).
+      */
+      static const CommandCreatorEntry COMMAND_CREATORS[];
 
-      static bool checkCommands(const std::vector<Command*>& commands, const std::string& text, uint32_t& pos, uint32_t last_pos);
+      /*
+         Lo que create() compila. No cambia después de creado, así que las
+         copias de la expresión y los hilos que la usan lo comparten.
+      */
+      struct Compiled
+      {
+         CommandArena arena;
+         CommandList command_sequence;
+         RegularMatcher* regular_matcher;
+         CommandProgram* command_program;
+         uint32_t jump_entry;
+         /*
+            Bytes con los que puede empezar una coincidencia no vacía.
+         */
+         ByteSearch start_bytes;
+         FirstSet first_set;
+         ByteSearch first_bytes;
+         /*
+            Si la expresión no llama a otras, los análisis pueden descartar
+            posiciones o textos donde no aparece este texto.
+         */
+         LiteralInfo required_literal;
+
+         /*
+            Empieza como el de una expresión vacía.
+         */
+         Compiled();
+         ~Compiled();
+
+         void createFirstSet();
+         void createRegularMatcher();
+         void createCommandProgram();
+         void createStartBytes();
+         void createRequiredLiteral(bool calls_expressions);
+      };
 
-      bool createCommand(Command*& command, const std::string& text, uint32_t& pos, uint32_t last_pos);
-      bool getCommandArgs(CommandArgs& args, const std::string& expression, uint32_t& pos, uint32_t last_pos);
-      bool getStringToken(CommandArgs& args, const std::string& expression, uint32_t& pos, uint32_t last_pos);
-      bool getCommandSequenceToken(CommandArgs& args, const std::string& expression, uint32_t& pos, uint32_t last_pos);
+      std::shared_ptr<const Compiled> compiled;
+      uint32_t error_pos;
+      bool has_factory_function;
+      FactoryFunction factory_function;
+      ParseMemo* parse_memo;
+      CallStack* call_stack;
+      CommandRegistry* command_registry;
+
+      typedef std::vector<std::pair<const FactoryFunction*, ParseProduct>> FactoryCalls;
+
+      /*
+         Si no es nulo, las llamadas a las funciones de fábrica del hilo se
+         guardan aquí en lugar de hacerse.
+      */
+      static thread_local FactoryCalls* deferred_factory_calls;
+
+      /*
+         Indica si pos está en el final del texto o en last_pos. Todos los
+         comandos la usan antes de leer, para que los análisis por partes
+         sepan que el resultado depende de lo que falta del texto.
+      */
+      static bool isEnd(std::string_view text, uint64_t pos, uint64_t last_pos);
+
+      static bool checkCommands(const CommandList& commands, std::string_view text, uint64_t& pos, uint64_t last_pos);
+      static bool getRegularBody(const CommandList& commands, RegularMatcher::Atom& atom);
+      static bool getLiteralCode(const std::string& literal, uint32_t& char_code);
+      static void compileCommands(const CommandList& commands, CommandProgram& program);
+      /*
+         Calcula los conjuntos iniciales de los comandos y el de la
+         secuencia. canStart() indica si una secuencia con esos bytes
+         iniciales puede empezar en pos, y al final del texto devuelve true
+         para que la secuencia lo marque como alcanzado.
+      */
+      static void createSequenceFirstSet(const CommandList& commands, FirstSet& sequence_set);
+      static bool canStart(const ByteSearch& bytes, std::string_view text, uint64_t pos, uint64_t last_pos);
+      static void compileFirstBytes(const ByteSearch& bytes, CommandProgram& program);
+      static void getSequenceLiteral(const CommandList& commands, LiteralInfo& info);
+      static void appendLiteral(LiteralInfo& info, const LiteralInfo& next);
+
+      static const std::shared_ptr<const Compiled>& getEmptyCompiled();
+
+      bool matchCommands(std::string_view text, uint64_t& pos, uint64_t last_pos) const;
+
+      /*
+         Compilador descendente: cada comando se crea apenas se leen sus
+         argumentos, y los argumentos que son secuencias ya llegan creados.
+         text termina en el last_pos de create(); si algo falla, error_pos
+         queda en la posición del error.
+      */
+      bool createCommand(Command*& command, std::string_view text, uint32_t& pos, CommandScope& scope);
+      bool createSequence(std::vector<Command*>& sequence, std::string_view text, uint32_t& pos, CommandScope& scope);
+      bool getCommandArgs(CommandArgs& args, std::string_view text, uint32_t& pos, CommandScope& scope);
+      bool getStringToken(CommandToken& token, std::string_view text, uint32_t& pos);
+
+      static bool findCommandCreator(std::string_view name, CommandCreator& creator);
+      /*
+         Clave con la que un CommandRegistry guarda el comando: el nombre,
+         los argumentos y los comandos ya compartidos de las secuencias.
+         Devuelve false si el comando no puede compartirse.
+      */
+      static bool getCommandKey(std::string_view name, const CommandArgs& args, std::string& key);
+      /*
+         Copia al arena los comandos de un argumento, para el comando que se
+         crea.
+      */
+      static bool takeSequence(CommandToken& token, CommandScope& scope, CommandList& sequence);
    };
 }
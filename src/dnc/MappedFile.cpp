@@ -0,0 +1,117 @@
+#include "MappedFile.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace dnc
+{
+   MappedFile::MappedFile() :
+      is_open(false),
+      data(nullptr),
+      size(0)
+   {}
+
+   MappedFile::~MappedFile()
+   {
+      close();
+   }
+
+   TextStatus MappedFile::open(const string& path)
+   {
+      close();
+
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if(fd < 0)
+      {
+         return TextStatus("cannot open '" + path + "': " + strerror(errno));
+      }
+
+      struct stat file_stat;
+      if(fstat(fd, &file_stat) < 0)
+      {
+         TextStatus status("cannot stat '" + path + "': " + strerror(errno));
+         ::close(fd);
+         return status;
+      }
+
+      if(!S_ISREG(file_stat.st_mode))
+      {
+         ::close(fd);
+         return TextStatus("'" + path + "' is not a regular file");
+      }
+
+      /*
+         mmap() no acepta una longitud nula, así que un archivo vacío queda
+         abierto sin proyección.
+      */
+      if(file_stat.st_size > 0)
+      {
+         void* mapped = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if(mapped == MAP_FAILED)
+         {
+            TextStatus status("cannot map '" + path + "': " + strerror(errno));
+            ::close(fd);
+            return status;
+         }
+
+         /*
+            Los comandos recorren el texto hacia adelante, por lo que se pide
+            una lectura anticipada agresiva y, si el núcleo lo permite,
+            páginas grandes. Son solo sugerencias y sus errores se ignoran.
+         */
+         madvise(mapped, file_stat.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+         madvise(mapped, file_stat.st_size, MADV_HUGEPAGE);
+#endif
+
+         data = mapped;
+         size = file_stat.st_size;
+      }
+
+      /*
+         La proyección no depende del descriptor.
+      */
+      ::close(fd);
+
+      is_open = true;
+      return TextStatus();
+   }
+
+   void MappedFile::close()
+   {
+      if(data != nullptr)
+      {
+         munmap(data, size);
+      }
+
+      is_open = false;
+      data = nullptr;
+      size = 0;
+   }
+
+   bool MappedFile::isOpen() const
+   {
+      return is_open;
+   }
+
+   string_view MappedFile::getText() const
+   {
+      if(data == nullptr)
+      {
+         return string_view();
+      }
+
+      return string_view(static_cast<const char*>(data), size);
+   }
+
+   uint64_t MappedFile::getSize() const
+   {
+      return size;
+   }
+}
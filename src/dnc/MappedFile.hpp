@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "TextStatus.hpp"
+
+namespace dnc
+{
+   /*
+      Archivo proyectado en memoria para analizarlo sin copiarlo. El texto se
+      puede pasar directamente a check(), Grammar::parse() o
+      UTF8Analyzer::ValidatedInput y sigue siendo válido mientras el objeto
+      exista y el archivo esté abierto.
+   */
+   class MappedFile
+   {
+   public:
+      MappedFile();
+      MappedFile(const MappedFile&) = delete;
+      ~MappedFile();
+
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      TextStatus open(const std::string& path);
+      void close();
+
+      bool isOpen() const;
+      std::string_view getText() const;
+      uint64_t getSize() const;
+
+   private:
+      bool is_open;
+      void* data;
+      uint64_t size;
+   };
+}
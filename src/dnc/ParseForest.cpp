@@ -0,0 +1,210 @@
+#include "ParseForest.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace dnc
+{
+   const uint32_t ParseForest::NO_NODE = uint32_t(-1);
+
+   ParseForest::ParseForest() :
+      productions(nullptr),
+      root(NO_NODE)
+   {}
+
+   ParseForest::~ParseForest()
+   {}
+
+   void ParseForest::clear()
+   {
+      productions = nullptr;
+      nodes.clear();
+      node_ids.clear();
+      root = NO_NODE;
+   }
+
+   uint32_t ParseForest::getRoot() const
+   {
+      return root;
+   }
+
+   uint32_t ParseForest::getNodeCount() const
+   {
+      return nodes.size();
+   }
+
+   const ParseForest::Node& ParseForest::getNode(uint32_t node) const
+   {
+      return nodes[node];
+   }
+
+   const LanguageExpression* ParseForest::getRule(const Alternative& alternative) const
+   {
+      return productions->getProductions()[alternative.production].rule;
+   }
+
+   void ParseForest::getChildren(const Alternative& alternative, vector<uint32_t>& children) const
+   {
+      children.clear();
+
+      const Alternative* current = &alternative;
+      while(true)
+      {
+         children.push_back(current->right);
+         if(current->left == NO_NODE)
+         {
+            break;
+         }
+
+         auto& left = nodes[current->left];
+         if(left.type != PARTIAL)
+         {
+            children.push_back(current->left);
+            break;
+         }
+         current = &left.alternatives[0];
+      }
+
+      reverse(children.begin(), children.end());
+   }
+
+   bool ParseForest::isAmbiguous() const
+   {
+      if(root == NO_NODE)
+      {
+         return false;
+      }
+
+      vector<bool> visited(nodes.size());
+      vector<uint32_t> pending = { root };
+      visited[root] = true;
+
+      while(!pending.empty())
+      {
+         auto& node = nodes[pending.back()];
+         pending.pop_back();
+
+         if(node.alternatives.size() > 1)
+         {
+            return true;
+         }
+
+         for(auto& alternative : node.alternatives)
+         {
+            for(auto child : { alternative.left, alternative.right })
+            {
+               if(child != NO_NODE && !visited[child])
+               {
+                  visited[child] = true;
+                  pending.push_back(child);
+               }
+            }
+         }
+      }
+
+      return false;
+   }
+
+   void ParseForest::produce() const
+   {
+      if(root == NO_NODE)
+      {
+         return;
+      }
+
+      /*
+         Cada regla se produce después de las de sus símbolos. Las cadenas
+         de operaciones pueden ser tan largas como el texto, así que se usa
+         una pila propia.
+      */
+      struct Step
+      {
+         uint32_t node;
+         bool expanded;
+      };
+
+      vector<Step> steps = { { root, false } };
+      vector<uint32_t> children;
+
+      while(!steps.empty())
+      {
+         Step step = steps.back();
+         steps.pop_back();
+
+         auto& node = nodes[step.node];
+         auto& alternative = getPreferred(node);
+
+         if(step.expanded)
+         {
+            productions->produce(alternative.production, ParseProduct(node.begin, node.end));
+            continue;
+         }
+
+         steps.push_back({ step.node, true });
+
+         getChildren(alternative, children);
+         for(uint32_t i = children.size(); i-- > 0;)
+         {
+            if(nodes[children[i]].type == GRAMMAR)
+            {
+               steps.push_back({ children[i], false });
+            }
+         }
+      }
+   }
+
+   bool ParseForest::NodeKey::operator==(const NodeKey& other) const
+   {
+      return type == other.type && symbol == other.symbol && dot == other.dot && begin == other.begin && end == other.end;
+   }
+
+   size_t ParseForest::NodeKeyHash::operator()(const NodeKey& key) const
+   {
+      uint64_t value = key.begin * 0x9E3779B97F4A7C15ull;
+      value ^= key.end + 0x7F4A7C15ull + (value << 6) + (value >> 2);
+      value ^= (uint64_t(key.symbol) << 34) ^ (uint64_t(key.dot) << 2) ^ key.type;
+      return value;
+   }
+
+   uint32_t ParseForest::addNode(NodeType type, uint32_t symbol, uint32_t dot, uint64_t begin, uint64_t end)
+   {
+      auto inserted = node_ids.insert({ { type, symbol, dot, begin, end }, uint32_t(nodes.size()) });
+      if(inserted.second)
+      {
+         nodes.push_back({ type, symbol, dot, begin, end, {} });
+      }
+
+      return inserted.first->second;
+   }
+
+   uint32_t ParseForest::findNode(NodeType type, uint32_t symbol, uint32_t dot, uint64_t begin, uint64_t end) const
+   {
+      auto found = node_ids.find({ type, symbol, dot, begin, end });
+      if(found == node_ids.end())
+      {
+         return NO_NODE;
+      }
+
+      return found->second;
+   }
+
+   void ParseForest::addAlternative(uint32_t node, const Alternative& alternative)
+   {
+      nodes[node].alternatives.push_back(alternative);
+   }
+
+   const ParseForest::Alternative& ParseForest::getPreferred(const Node& node) const
+   {
+      const Alternative* preferred = &node.alternatives[0];
+      for(auto& alternative : node.alternatives)
+      {
+         if(alternative.production < preferred->production)
+         {
+            preferred = &alternative;
+         }
+      }
+
+      return *preferred;
+   }
+}
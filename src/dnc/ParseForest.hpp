@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "GrammarProductions.hpp"
+
+namespace dnc
+{
+   /*
+      Bosque compartido con todos los análisis de un texto. Cada nodo es la
+      gramática, un terminal o el comienzo de una producción (sus primeros
+      símbolos) sobre un tramo del texto, y tiene una alternativa por cada
+      forma de obtenerlo. Un tramo que se analiza de varias formas aparece
+      una sola vez, por lo que el tamaño del bosque es a lo sumo cúbico
+      aunque la cantidad de árboles sea exponencial.
+   */
+   class ParseForest
+   {
+   public:
+      enum NodeType
+      {
+         GRAMMAR,
+         TOKEN,
+         PARTIAL
+      };
+
+      static const uint32_t NO_NODE;
+
+      /*
+         right es el último símbolo y left, el nodo con los anteriores
+         (NO_NODE si no hay ninguno, o el propio símbolo si hay uno solo).
+      */
+      struct Alternative
+      {
+         uint32_t production;
+         uint32_t left;
+         uint32_t right;
+      };
+
+      /*
+         symbol es el terminal de un nodo TOKEN o la producción de un nodo
+         PARTIAL, cuyos primeros dot símbolos cubren el tramo.
+      */
+      struct Node
+      {
+         NodeType type;
+         uint32_t symbol;
+         uint32_t dot;
+         uint64_t begin;
+         uint64_t end;
+         std::vector<Alternative> alternatives;
+      };
+
+      ParseForest();
+      ~ParseForest();
+
+      void clear();
+
+      uint32_t getRoot() const;
+      uint32_t getNodeCount() const;
+      const Node& getNode(uint32_t node) const;
+      const LanguageExpression* getRule(const Alternative& alternative) const;
+
+      /*
+         Los símbolos de una alternativa de un nodo GRAMMAR, en orden. De
+         los nodos PARTIAL con varias alternativas se usa la primera.
+      */
+      void getChildren(const Alternative& alternative, std::vector<uint32_t>& children) const;
+
+      /*
+         Indica si algún nodo que se usa desde la raíz tiene más de una
+         alternativa.
+      */
+      bool isAmbiguous() const;
+
+      /*
+         Llama a las funciones de fábrica de uno de los árboles: en cada
+         nodo GRAMMAR, el de la regla declarada antes.
+      */
+      void produce() const;
+
+   private:
+      friend class EarleyParser;
+
+      struct NodeKey
+      {
+         NodeType type;
+         uint32_t symbol;
+         uint32_t dot;
+         uint64_t begin;
+         uint64_t end;
+
+         bool operator==(const NodeKey& other) const;
+      };
+
+      struct NodeKeyHash
+      {
+         size_t operator()(const NodeKey& key) const;
+      };
+
+      const GrammarProductions* productions;
+      std::vector<Node> nodes;
+      std::unordered_map<NodeKey, uint32_t, NodeKeyHash> node_ids;
+      uint32_t root;
+
+      uint32_t addNode(NodeType type, uint32_t symbol, uint32_t dot, uint64_t begin, uint64_t end);
+      uint32_t findNode(NodeType type, uint32_t symbol, uint32_t dot, uint64_t begin, uint64_t end) const;
+      /*
+         EarleyParser agrega cada alternativa una sola vez.
+      */
+      void addAlternative(uint32_t node, const Alternative& alternative);
+      const Alternative& getPreferred(const Node& node) const;
+   };
+}
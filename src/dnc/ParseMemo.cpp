@@ -0,0 +1,168 @@
+#include "ParseMemo.hpp"
+
+#include "LanguageExpression.hpp"
+#include "CallStack.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   thread_local ParseMemo* ParseMemo::active = nullptr;
+
+   /*
+      class ParseMemo::Scope
+   */
+   ParseMemo::Scope::Scope(ParseMemo* memo) :
+      outer(false)
+   {
+      if(memo != nullptr && active == nullptr)
+      {
+         memo->clear();
+         active = memo;
+         outer = true;
+      }
+   }
+
+   ParseMemo::Scope::~Scope()
+   {
+      if(outer)
+      {
+         active = nullptr;
+      }
+   }
+
+   bool ParseMemo::Scope::isOuter() const
+   {
+      return outer;
+   }
+
+   /*
+      class ParseMemo
+   */
+   ParseMemo::ParseMemo(bool bounded) :
+      bounded(bounded),
+      committed_pos(0),
+      entry_count(0),
+      hit_count(0)
+   {}
+
+   ParseMemo::~ParseMemo()
+   {}
+
+   void ParseMemo::clear()
+   {
+      columns.clear();
+      committed_pos = 0;
+      entry_count = 0;
+      hit_count = 0;
+   }
+
+   void ParseMemo::commit(uint64_t pos)
+   {
+      if(pos <= committed_pos)
+      {
+         return;
+      }
+      committed_pos = pos;
+
+      if(!bounded)
+      {
+         return;
+      }
+
+      auto end = columns.lower_bound(committed_pos);
+      for(auto column = columns.begin(); column != end; ++column)
+      {
+         entry_count -= column->second.size();
+      }
+      columns.erase(columns.begin(), end);
+   }
+
+   uint32_t ParseMemo::getColumnCount() const
+   {
+      return columns.size();
+   }
+
+   uint64_t ParseMemo::getEntryCount() const
+   {
+      return entry_count;
+   }
+
+   uint64_t ParseMemo::getHitCount() const
+   {
+      return hit_count;
+   }
+
+   bool ParseMemo::check(const LanguageExpression* expression, string_view text, uint64_t& pos, uint64_t last_pos)
+   {
+      return call(expression, false, text, pos, last_pos);
+   }
+
+   bool ParseMemo::jumpAndCheck(const LanguageExpression* expression, string_view text, uint64_t& pos, uint64_t last_pos)
+   {
+      return call(expression, true, text, pos, last_pos);
+   }
+
+   bool ParseMemo::call(const LanguageExpression* expression, bool jump, string_view text, uint64_t& pos, uint64_t last_pos)
+   {
+      /*
+         Si la expresión no puede empezar en pos, no hace falta analizarla
+         ni guardar el resultado.
+      */
+      if(!jump && !expression->canStartAt(text, pos, last_pos))
+      {
+         return false;
+      }
+
+      ParseMemo* memo = active;
+      if(memo == nullptr)
+      {
+         return evaluate(expression, jump, text, pos, last_pos);
+      }
+
+      Key key(expression, last_pos, jump);
+
+      auto column = memo->columns.find(pos);
+      if(column != memo->columns.end())
+      {
+         auto found = column->second.find(key);
+         if(found != column->second.end())
+         {
+            memo->hit_count += 1;
+            if(found->second.success)
+            {
+               pos = found->second.end_pos;
+            }
+            return found->second.success;
+         }
+      }
+
+      uint64_t init_pos = pos;
+      bool success = evaluate(expression, jump, text, pos, last_pos);
+
+      /*
+         En modo acotado no se guardan columnas que ya se descartaron.
+      */
+      if(!memo->bounded || init_pos >= memo->committed_pos)
+      {
+         auto inserted = memo->columns[init_pos].insert({ key, { success, pos } });
+         if(inserted.second)
+         {
+            memo->entry_count += 1;
+         }
+      }
+
+      return success;
+   }
+
+   bool ParseMemo::evaluate(const LanguageExpression* expression, bool jump, string_view text, uint64_t& pos, uint64_t last_pos)
+   {
+      return CallStack::call([&] {
+         if(jump)
+         {
+            return expression->jumpAndCheck(text, pos, last_pos);
+         }
+         return expression->checkAndAdvance(text, pos, last_pos, true);
+      });
+   }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <string>
+#include <string_view>
+
+namespace dnc
+{
+   class LanguageExpression;
+
+   /*
+      Tabla de resultados de las llamadas a subexpresiones (EXP() y las
+      reglas de Grammar) durante un mismo análisis, para no volver a
+      analizar la misma expresión en la misma posición.
+
+      Mientras un resultado se reutiliza, las funciones de fábrica de esa
+      llamada no se vuelven a ejecutar. Una tabla no debe usarse desde
+      varios hilos a la vez.
+   */
+   class ParseMemo
+   {
+   public:
+      /*
+         Activa la tabla durante un análisis. Solo el ámbito más externo la
+         instala y la vacía; los demás no hacen nada.
+      */
+      class Scope
+      {
+      public:
+         Scope(ParseMemo* memo);
+         ~Scope();
+
+         bool isOuter() const;
+
+      private:
+         bool outer;
+      };
+
+      /*
+         En modo acotado se descartan las columnas anteriores a la posición
+         más avanzada que el análisis externo ya no puede revisar.
+      */
+      ParseMemo(bool bounded = false);
+      ~ParseMemo();
+
+      void clear();
+      void commit(uint64_t pos);
+
+      uint32_t getColumnCount() const;
+      uint64_t getEntryCount() const;
+      uint64_t getHitCount() const;
+
+      static bool check(const LanguageExpression* expression, std::string_view text, uint64_t& pos, uint64_t last_pos);
+      static bool jumpAndCheck(const LanguageExpression* expression, std::string_view text, uint64_t& pos, uint64_t last_pos);
+
+   private:
+      struct Entry
+      {
+         bool success;
+         uint64_t end_pos;
+      };
+
+      typedef std::tuple<const LanguageExpression*, uint64_t, bool> Key;
+      typedef std::map<Key, Entry> Column;
+
+      static thread_local ParseMemo* active;
+
+      std::map<uint64_t, Column> columns;
+      bool bounded;
+      uint64_t committed_pos;
+      uint64_t entry_count;
+      uint64_t hit_count;
+
+      static bool call(const LanguageExpression* expression, bool jump, std::string_view text, uint64_t& pos, uint64_t last_pos);
+      /*
+         Analiza la expresión como una llamada anidada (ver CallStack).
+      */
+      static bool evaluate(const LanguageExpression* expression, bool jump, std::string_view text, uint64_t& pos, uint64_t last_pos);
+   };
+}
\ No newline at end of file
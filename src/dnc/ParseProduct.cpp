@@ -10,7 +10,7 @@ namespace dnc
       end_pos(0)
    {}
 
-   ParseProduct::ParseProduct(uint32_t begin_pos, uint32_t end_pos) :
+   ParseProduct::ParseProduct(uint64_t begin_pos, uint64_t end_pos) :
       status(true),
       begin_pos(begin_pos),
       end_pos(end_pos)
@@ -21,12 +21,12 @@ namespace dnc
       return status;
    }
 
-   uint32_t ParseProduct::begin() const
+   uint64_t ParseProduct::begin() const
    {
       return begin_pos;
    }
 
-   uint32_t ParseProduct::end() const
+   uint64_t ParseProduct::end() const
    {
       return end_pos;
    }
@@ -9,15 +9,15 @@ namespace dnc
    {
    public:
       ParseProduct();
-      ParseProduct(uint32_t begin_pos, uint32_t end_pos);
+      ParseProduct(uint64_t begin_pos, uint64_t end_pos);
 
       bool ok() const;
-      uint32_t begin() const;
-      uint32_t end() const;
+      uint64_t begin() const;
+      uint64_t end() const;
 
    private:
       bool status;
-      uint32_t begin_pos;
-      uint32_t end_pos;
+      uint64_t begin_pos;
+      uint64_t end_pos;
    };
 }
\ No newline at end of file
@@ -0,0 +1,537 @@
+#include "ParseTable.hpp"
+
+#include <map>
+#include <algorithm>
+
+#include "UTF8Analyzer.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   namespace
+   {
+      /*
+         Producción y posición del punto.
+      */
+      typedef pair<uint32_t, uint32_t> Item;
+
+      struct State
+      {
+         vector<Item> kernel;
+         vector<vector<bool>> lookaheads;
+         vector<int32_t> transitions;
+      };
+
+      bool addSet(vector<bool>& set, const vector<bool>& other)
+      {
+         bool changed = false;
+         for(uint32_t i = 0; i < set.size(); ++i)
+         {
+            if(other[i] && !set[i])
+            {
+               set[i] = true;
+               changed = true;
+            }
+         }
+
+         return changed;
+      }
+   }
+
+   ParseTable::ParseTable() :
+      state_count(0)
+   {}
+
+   ParseTable::~ParseTable()
+   {}
+
+   bool ParseTable::create(const LanguageExpression* grammar, const vector<const LanguageExpression*>& rules, const vector<Precedence>& precedences)
+   {
+      clear();
+
+      if(!grammar_productions.create(grammar, rules))
+      {
+         return false;
+      }
+
+      productions.push_back({ nullptr, { GrammarProductions::NONTERMINAL }, false, 0, false });
+      token_precedences.assign(grammar_productions.getTokens().size(), { false, 0 });
+
+      for(auto& grammar_production : grammar_productions.getProductions())
+      {
+         Production production = { grammar_production.rule, grammar_production.symbols, false, 0, false };
+         for(auto& precedence : precedences)
+         {
+            if(precedence.rule == production.rule)
+            {
+               production.has_precedence = true;
+               production.precedence = precedence.precedence;
+               production.right_associative = precedence.right_associative;
+            }
+         }
+
+         if(production.has_precedence)
+         {
+            for(auto symbol : production.symbols)
+            {
+               if(symbol != GrammarProductions::NONTERMINAL && !token_precedences[symbol].has_precedence)
+               {
+                  token_precedences[symbol] = { true, production.precedence };
+               }
+            }
+         }
+
+         productions.push_back(production);
+      }
+
+      createStates();
+      return true;
+   }
+
+   void ParseTable::clear()
+   {
+      grammar_productions.clear();
+      productions.clear();
+      token_precedences.clear();
+      state_count = 0;
+      actions.clear();
+      gotos.clear();
+      state_tokens.clear();
+      state_token_begin.clear();
+      conflicts.clear();
+   }
+
+   const vector<ParseTable::Conflict>& ParseTable::getConflicts() const
+   {
+      return conflicts;
+   }
+
+   uint32_t ParseTable::getStateCount() const
+   {
+      return state_count;
+   }
+
+   uint32_t ParseTable::getTokenCount() const
+   {
+      return grammar_productions.getTokens().size();
+   }
+
+   bool ParseTable::parse(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const
+   {
+      /*
+         Un terminal puede volver a llamar a la gramática desde dentro de
+         otro comando, así que la pila es del hilo, igual que en
+         CommandProgram::run().
+      */
+      thread_local vector<Entry> stack;
+      thread_local vector<Reduction> reductions;
+
+      const uint32_t stack_base = stack.size();
+      const uint32_t reduction_base = reductions.size();
+      const uint32_t end_token = grammar_productions.getTokens().size();
+      const uint32_t columns = end_token + 1;
+
+      uint64_t current_pos = pos;
+      stack.push_back({ 0, pos });
+
+      bool has_lookahead = false;
+      uint32_t lookahead = end_token;
+      uint64_t lookahead_end = pos;
+
+      /*
+         Con ignore_rest, posiciones donde el texto podría terminar.
+      */
+      vector<uint64_t> ends;
+
+      bool result = false;
+      while(true)
+      {
+         uint32_t state = stack.back().state;
+
+         if(!has_lookahead)
+         {
+            lookahead = end_token;
+            lookahead_end = current_pos;
+
+            if(current_pos >= last_pos || current_pos >= text.size())
+            {
+               UTF8Analyzer::setEndReached();
+            }
+            else
+            {
+               if(ignore_rest && current_pos > pos && actions[state * columns + end_token].type != NO_ACTION)
+               {
+                  ends.push_back(current_pos);
+               }
+
+               for(uint32_t i = state_token_begin[state]; i < state_token_begin[state + 1]; ++i)
+               {
+                  uint64_t token_end = current_pos;
+                  if(grammar_productions.matchToken(state_tokens[i], text, token_end, last_pos))
+                  {
+                     lookahead = state_tokens[i];
+                     lookahead_end = token_end;
+                     break;
+                  }
+               }
+
+               if(lookahead == end_token && !ignore_rest)
+               {
+                  break;
+               }
+            }
+
+            has_lookahead = true;
+         }
+
+         const Action& action = actions[state * columns + lookahead];
+         if(action.type == SHIFT)
+         {
+            stack.push_back({ action.value, current_pos });
+            current_pos = lookahead_end;
+            has_lookahead = false;
+         }
+         else if(action.type == REDUCE)
+         {
+            uint32_t first = stack.size() - productions[action.value].symbols.size();
+            uint64_t begin = stack[first].begin;
+            stack.resize(first);
+
+            reductions.push_back({ action.value - 1, ParseProduct(begin, current_pos) });
+
+            stack.push_back({ gotos[stack.back().state], begin });
+         }
+         else
+         {
+            if(action.type == ACCEPT)
+            {
+               pos = current_pos;
+               result = true;
+            }
+            break;
+         }
+      }
+
+      stack.resize(stack_base);
+
+      /*
+         Una función de fábrica puede volver a analizar la gramática y
+         agregar reducciones, así que se copia cada una antes de llamarla.
+      */
+      if(result)
+      {
+         for(uint32_t i = reduction_base; i < reductions.size(); ++i)
+         {
+            Reduction reduction = reductions[i];
+            grammar_productions.produce(reduction.production, reduction.product);
+         }
+      }
+      reductions.resize(reduction_base);
+
+      /*
+         Los terminales no vuelven atrás, así que un texto que no se pudo
+         seguir se prueba terminado en cada posición anotada, de la última
+         a la primera, para aceptar el comienzo más largo.
+      */
+      while(!result && !ends.empty())
+      {
+         uint64_t end_pos = pos;
+         if(parse(text, end_pos, ends.back(), false))
+         {
+            pos = end_pos;
+            result = true;
+         }
+         ends.pop_back();
+      }
+
+      return result;
+   }
+
+   void ParseTable::createStates()
+   {
+      const uint32_t end_token = grammar_productions.getTokens().size();
+      const uint32_t columns = end_token + 1;
+
+      /*
+         Como la gramática no coincide sin avanzar, empieza con el primer
+         terminal de alguna producción.
+      */
+      vector<bool> first(columns);
+      for(uint32_t p = 1; p < productions.size(); ++p)
+      {
+         if(productions[p].symbols[0] != GrammarProductions::NONTERMINAL)
+         {
+            first[productions[p].symbols[0]] = true;
+         }
+      }
+
+      auto addNext = [&](vector<bool>& set, const Production& production, uint32_t index, const vector<bool>& lookahead) {
+         if(index == production.symbols.size())
+         {
+            addSet(set, lookahead);
+         }
+         else if(production.symbols[index] == GrammarProductions::NONTERMINAL)
+         {
+            addSet(set, first);
+         }
+         else set[production.symbols[index]] = true;
+      };
+
+      /*
+         Con un solo no terminal, todas las producciones que agrega la
+         clausura tienen los mismos símbolos de anticipación.
+      */
+      auto closure = [&](const State& state, vector<bool>& lookahead) -> bool {
+         bool expanded = false;
+         lookahead.assign(columns, false);
+         for(uint32_t i = 0; i < state.kernel.size(); ++i)
+         {
+            auto& production = productions[state.kernel[i].first];
+            uint32_t dot = state.kernel[i].second;
+            if(dot < production.symbols.size() && production.symbols[dot] == GrammarProductions::NONTERMINAL)
+            {
+               addNext(lookahead, production, dot + 1, state.lookaheads[i]);
+               expanded = true;
+            }
+         }
+
+         if(expanded)
+         {
+            for(uint32_t p = 1; p < productions.size(); ++p)
+            {
+               auto& production = productions[p];
+               if(production.symbols[0] == GrammarProductions::NONTERMINAL && production.symbols.size() > 1)
+               {
+                  addNext(lookahead, production, 1, lookahead);
+               }
+            }
+         }
+
+         return expanded;
+      };
+
+      /*
+         Se construyen los estados LR(1) uniendo los que tienen el mismo
+         núcleo, y cada estado cuyos símbolos de anticipación crecen se
+         vuelve a procesar.
+      */
+      vector<State> states(1);
+      states[0].kernel = { Item(0, 0) };
+      states[0].lookaheads = { vector<bool>(columns) };
+      states[0].lookaheads[0][end_token] = true;
+
+      map<vector<Item>, uint32_t> state_ids;
+      state_ids[states[0].kernel] = 0;
+
+      vector<uint32_t> pending = { 0 };
+      vector<bool> is_pending = { true };
+
+      while(!pending.empty())
+      {
+         uint32_t s = pending.back();
+         pending.pop_back();
+         is_pending[s] = false;
+
+         vector<bool> lookahead;
+         bool expanded = closure(states[s], lookahead);
+
+         /*
+            El no terminal usa la columna del final del texto.
+         */
+         vector<vector<Item>> kernels(columns);
+         vector<vector<vector<bool>>> kernel_lookaheads(columns);
+
+         auto advance = [&](const Item& item, const vector<bool>& item_lookahead) {
+            auto& symbols = productions[item.first].symbols;
+            if(item.second < symbols.size())
+            {
+               uint32_t symbol = symbols[item.second] == GrammarProductions::NONTERMINAL ? end_token : symbols[item.second];
+               kernels[symbol].push_back(Item(item.first, item.second + 1));
+               kernel_lookaheads[symbol].push_back(item_lookahead);
+            }
+         };
+
+         for(uint32_t i = 0; i < states[s].kernel.size(); ++i)
+         {
+            advance(states[s].kernel[i], states[s].lookaheads[i]);
+         }
+         if(expanded)
+         {
+            for(uint32_t p = 1; p < productions.size(); ++p)
+            {
+               advance(Item(p, 0), lookahead);
+            }
+         }
+
+         vector<int32_t> transitions(columns, -1);
+         for(uint32_t symbol = 0; symbol < columns; ++symbol)
+         {
+            if(kernels[symbol].empty())
+            {
+               continue;
+            }
+
+            vector<uint32_t> order(kernels[symbol].size());
+            for(uint32_t i = 0; i < order.size(); ++i)
+            {
+               order[i] = i;
+            }
+            sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+               return kernels[symbol][a] < kernels[symbol][b];
+            });
+
+            State next;
+            for(auto i : order)
+            {
+               next.kernel.push_back(kernels[symbol][i]);
+               next.lookaheads.push_back(kernel_lookaheads[symbol][i]);
+            }
+
+            uint32_t id;
+            auto found = state_ids.find(next.kernel);
+            if(found == state_ids.end())
+            {
+               id = states.size();
+               state_ids[next.kernel] = id;
+               states.push_back(next);
+
+               pending.push_back(id);
+               is_pending.push_back(true);
+            }
+            else
+            {
+               id = found->second;
+
+               bool changed = false;
+               for(uint32_t i = 0; i < next.kernel.size(); ++i)
+               {
+                  changed = addSet(states[id].lookaheads[i], next.lookaheads[i]) || changed;
+               }
+
+               if(changed && !is_pending[id])
+               {
+                  pending.push_back(id);
+                  is_pending[id] = true;
+               }
+            }
+
+            transitions[symbol] = id;
+         }
+
+         states[s].transitions = transitions;
+      }
+
+      state_count = states.size();
+      actions.assign(state_count * columns, { NO_ACTION, 0 });
+      gotos.assign(state_count, 0);
+
+      for(uint32_t s = 0; s < state_count; ++s)
+      {
+         auto& state = states[s];
+         Action* row = &actions[s * columns];
+
+         for(uint32_t t = 0; t < end_token; ++t)
+         {
+            if(state.transitions[t] >= 0)
+            {
+               row[t] = { SHIFT, uint32_t(state.transitions[t]) };
+            }
+         }
+
+         if(state.transitions[end_token] >= 0)
+         {
+            gotos[s] = state.transitions[end_token];
+         }
+
+         /*
+            El núcleo está ordenado, así que las reducciones se agregan en
+            el orden de las reglas.
+         */
+         for(uint32_t i = 0; i < state.kernel.size(); ++i)
+         {
+            uint32_t p = state.kernel[i].first;
+            auto& production = productions[p];
+            if(state.kernel[i].second < production.symbols.size())
+            {
+               continue;
+            }
+
+            if(p == 0)
+            {
+               row[end_token] = { ACCEPT, 0 };
+               continue;
+            }
+
+            for(uint32_t t = 0; t < columns; ++t)
+            {
+               if(!state.lookaheads[i][t])
+               {
+                  continue;
+               }
+
+               Action& action = row[t];
+               if(action.type == NO_ACTION)
+               {
+                  action = { REDUCE, p };
+               }
+               else if(action.type == SHIFT)
+               {
+                  auto& token = token_precedences[t];
+                  if(!production.has_precedence || !token.has_precedence)
+                  {
+                     addConflict(production.rule, grammar_productions.getTokens()[t].rule, true);
+                  }
+                  else if(production.precedence > token.precedence || (production.precedence == token.precedence && !production.right_associative))
+                  {
+                     action = { REDUCE, p };
+                  }
+               }
+               else if(action.type == REDUCE && action.value != p)
+               {
+                  addConflict(productions[action.value].rule, production.rule, false);
+               }
+            }
+         }
+
+         state_token_begin.push_back(state_tokens.size());
+         for(uint32_t t = 0; t < end_token; ++t)
+         {
+            if(row[t].type != NO_ACTION)
+            {
+               state_tokens.push_back(t);
+            }
+         }
+
+         /*
+            De los terminales esperados se lee el primero que coincide, así
+            que dos que pueden empezar con el mismo texto son un conflicto.
+         */
+         auto& tokens = grammar_productions.getTokens();
+         for(uint32_t i = state_token_begin.back(); i < state_tokens.size(); ++i)
+         {
+            for(uint32_t j = i + 1; j < state_tokens.size(); ++j)
+            {
+               if(grammar_productions.canOverlap(state_tokens[i], state_tokens[j]))
+               {
+                  addConflict(tokens[state_tokens[i]].rule, tokens[state_tokens[j]].rule, false, true);
+               }
+            }
+         }
+      }
+      state_token_begin.push_back(state_tokens.size());
+   }
+
+   void ParseTable::addConflict(const LanguageExpression* rule, const LanguageExpression* other, bool shift, bool overlap)
+   {
+      for(auto& conflict : conflicts)
+      {
+         if(conflict.rule == rule && conflict.other == other && conflict.shift == shift && conflict.overlap == overlap)
+         {
+            return;
+         }
+      }
+
+      conflicts.push_back({ rule, other, shift, overlap });
+   }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "GrammarProductions.hpp"
+
+namespace dnc
+{
+   /*
+      Tabla LALR(1) de las producciones de una gramática (ver
+      GrammarProductions). Los terminales solo se prueban en los estados
+      donde se esperan.
+   */
+   class ParseTable
+   {
+   public:
+      /*
+         Precedencia de una regla y de los terminales que aparecen en ella
+         (si están en varias reglas, la de la primera que la tiene). Entre
+         reducir una regla y desplazar un terminal gana la mayor; si son
+         iguales, se reduce, salvo que la regla sea asociativa a derecha.
+      */
+      struct Precedence
+      {
+         const LanguageExpression* rule;
+         uint32_t precedence;
+         bool right_associative;
+      };
+
+      /*
+         Conflicto que las precedencias no resuelven. Si shift es true, se
+         desplaza el terminal de other en lugar de reducir rule; si no, se
+         reduce rule, que se declaró antes que other.
+
+         Si overlap es true, en algún estado se esperan un terminal de rule
+         y otro de other que pueden empezar con el mismo byte. Se lee solo
+         el primero que coincide, el de rule, aunque con el de other el
+         texto sí se aceptaría.
+      */
+      struct Conflict
+      {
+         const LanguageExpression* rule;
+         const LanguageExpression* other;
+         bool shift;
+         bool overlap;
+      };
+
+      ParseTable();
+      ~ParseTable();
+
+      /*
+         Falla si las reglas no forman producciones.
+      */
+      bool create(const LanguageExpression* grammar, const std::vector<const LanguageExpression*>& rules, const std::vector<Precedence>& precedences);
+      void clear();
+
+      const std::vector<Conflict>& getConflicts() const;
+      uint32_t getStateCount() const;
+      uint32_t getTokenCount() const;
+
+      /*
+         Si el texto se acepta, llama a la función de fábrica de cada regla
+         en el orden en que se redujo. Si ignore_rest es true, se acepta el
+         comienzo más largo del texto que termina después de un terminal.
+
+         El lenguaje aceptado puede ser distinto del de Grammar::parse() sin
+         tabla, que se queda con la primera regla que coincide: con las
+         reglas UCHAR("c") y UCHAR("c")EXP(0), "cc" se acepta con la tabla y
+         no con las reglas.
+      */
+      bool parse(std::string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const;
+
+   private:
+      /*
+         La producción 0 acepta la gramática completa; la producción p es
+         la p - 1 de grammar_productions.
+      */
+      struct Production
+      {
+         const LanguageExpression* rule;
+         std::vector<int32_t> symbols;
+         bool has_precedence;
+         uint32_t precedence;
+         bool right_associative;
+      };
+
+      struct TokenPrecedence
+      {
+         bool has_precedence;
+         uint32_t precedence;
+      };
+
+      enum ActionType
+      {
+         NO_ACTION,
+         SHIFT,
+         REDUCE,
+         ACCEPT
+      };
+
+      struct Action
+      {
+         ActionType type;
+         uint32_t value;
+      };
+
+      struct Entry
+      {
+         uint32_t state;
+         uint64_t begin;
+      };
+
+      struct Reduction
+      {
+         uint32_t production;
+         ParseProduct product;
+      };
+
+      GrammarProductions grammar_productions;
+      std::vector<Production> productions;
+      std::vector<TokenPrecedence> token_precedences;
+      uint32_t state_count;
+      /*
+         Una fila por estado, con una columna por terminal y una más para el
+         final del texto.
+      */
+      std::vector<Action> actions;
+      std::vector<uint32_t> gotos;
+      /*
+         Terminales que se prueban en cada estado, en el orden en que
+         aparecen en las reglas.
+      */
+      std::vector<uint32_t> state_tokens;
+      std::vector<uint32_t> state_token_begin;
+      std::vector<Conflict> conflicts;
+
+      void createStates();
+      void addConflict(const LanguageExpression* rule, const LanguageExpression* other, bool shift, bool overlap = false);
+   };
+}
@@ -0,0 +1,423 @@
+#include "PredictiveTable.hpp"
+
+#include "UTF8Analyzer.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   const int32_t PredictiveTable::NO_ACTION = -1;
+   const int32_t PredictiveTable::END_CONTINUATION = -2;
+
+   PredictiveTable::PredictiveTable()
+   {}
+
+   PredictiveTable::~PredictiveTable()
+   {}
+
+   bool PredictiveTable::create(const LanguageExpression* grammar, const vector<const LanguageExpression*>& rules)
+   {
+      clear();
+
+      if(!grammar_productions.create(grammar, rules))
+      {
+         return false;
+      }
+
+      createRows();
+      return true;
+   }
+
+   void PredictiveTable::clear()
+   {
+      grammar_productions.clear();
+      actions.clear();
+      row_tokens[GRAMMAR_ROW].clear();
+      row_tokens[CONTINUATION_ROW].clear();
+      conflicts.clear();
+   }
+
+   const vector<PredictiveTable::Conflict>& PredictiveTable::getConflicts() const
+   {
+      return conflicts;
+   }
+
+   uint32_t PredictiveTable::getTokenCount() const
+   {
+      return grammar_productions.getTokens().size();
+   }
+
+   bool PredictiveTable::parse(string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const
+   {
+      if(!conflicts.empty())
+      {
+         return false;
+      }
+
+      /*
+         Un terminal puede volver a llamar a la gramática desde dentro de
+         otro comando, así que la pila es del hilo, igual que en
+         ParseTable::parse().
+      */
+      thread_local vector<Entry> stack;
+      thread_local vector<Reduction> reductions;
+
+      const uint32_t stack_base = stack.size();
+      const uint32_t reduction_base = reductions.size();
+      const uint32_t end_token = grammar_productions.getTokens().size();
+      const uint32_t columns = end_token + 1;
+      auto& productions = grammar_productions.getProductions();
+
+      uint64_t current_pos = pos;
+      stack.push_back({ GRAMMAR, 0, pos });
+
+      /*
+         Entradas de la pila que tienen que leer algo (terminales y la
+         gramática). Sin ellas, el texto puede terminar en current_pos.
+      */
+      uint32_t pending = 1;
+
+      /*
+         El terminal siguiente se busca una vez por fila en cada posición.
+      */
+      bool has_lookahead = false;
+      Row lookahead_row = GRAMMAR_ROW;
+      uint64_t lookahead_pos = pos;
+      uint32_t lookahead = end_token;
+      uint64_t lookahead_end = pos;
+
+      /*
+         Con ignore_rest, posiciones donde el texto podría terminar.
+      */
+      vector<uint64_t> ends;
+
+      bool result = false;
+      while(true)
+      {
+         const bool at_end = current_pos >= last_pos || current_pos >= text.size();
+
+         if(stack.size() == stack_base)
+         {
+            if(at_end)
+            {
+               UTF8Analyzer::setEndReached();
+            }
+
+            result = at_end || ignore_rest;
+            break;
+         }
+
+         Entry entry = stack.back();
+         stack.pop_back();
+
+         if(entry.type == PRODUCE)
+         {
+            reductions.push_back({ entry.value, ParseProduct(entry.begin, current_pos) });
+            continue;
+         }
+
+         if(entry.type == TOKEN)
+         {
+            --pending;
+
+            uint64_t token_end = current_pos;
+            if(has_lookahead && lookahead_pos == current_pos && lookahead == entry.value)
+            {
+               token_end = lookahead_end;
+            }
+            else if(!grammar_productions.matchToken(entry.value, text, token_end, last_pos))
+            {
+               break;
+            }
+
+            current_pos = token_end;
+            if(ignore_rest && pending == 0)
+            {
+               ends.push_back(current_pos);
+            }
+            continue;
+         }
+
+         Row row = entry.type == GRAMMAR ? GRAMMAR_ROW : CONTINUATION_ROW;
+         if(entry.type == GRAMMAR)
+         {
+            --pending;
+         }
+
+         if(!has_lookahead || lookahead_pos != current_pos || lookahead_row != row)
+         {
+            lookahead = end_token;
+            lookahead_end = current_pos;
+
+            if(at_end)
+            {
+               UTF8Analyzer::setEndReached();
+            }
+            else
+            {
+               for(auto token : row_tokens[row])
+               {
+                  uint64_t token_end = current_pos;
+                  if(grammar_productions.matchToken(token, text, token_end, last_pos))
+                  {
+                     lookahead = token;
+                     lookahead_end = token_end;
+                     break;
+                  }
+               }
+
+               if(lookahead == end_token && !ignore_rest)
+               {
+                  break;
+               }
+            }
+
+            has_lookahead = true;
+            lookahead_row = row;
+            lookahead_pos = current_pos;
+         }
+
+         int32_t action = actions[row * columns + lookahead];
+         if(action == NO_ACTION)
+         {
+            break;
+         }
+
+         if(action == END_CONTINUATION)
+         {
+            continue;
+         }
+
+         /*
+            Sin recursión a izquierda, una regla que empieza con la
+            gramática continúa lo que empieza en begin, así que no vuelve a
+            leer la gramática.
+         */
+         auto& symbols = productions[action].symbols;
+         uint64_t begin = row == GRAMMAR_ROW ? current_pos : entry.begin;
+         uint32_t first = row == GRAMMAR_ROW ? 0 : 1;
+
+         stack.push_back({ CONTINUATION, 0, begin });
+         stack.push_back({ PRODUCE, uint32_t(action), begin });
+         for(uint32_t i = symbols.size(); i > first; --i)
+         {
+            int32_t symbol = symbols[i - 1];
+            if(symbol == GrammarProductions::NONTERMINAL)
+            {
+               stack.push_back({ GRAMMAR, 0, 0 });
+            }
+            else stack.push_back({ TOKEN, uint32_t(symbol), 0 });
+            ++pending;
+         }
+      }
+
+      stack.resize(stack_base);
+
+      /*
+         Una función de fábrica puede volver a analizar la gramática y
+         agregar reducciones, así que se copia cada una antes de llamarla.
+      */
+      if(result)
+      {
+         pos = current_pos;
+         for(uint32_t i = reduction_base; i < reductions.size(); ++i)
+         {
+            Reduction reduction = reductions[i];
+            grammar_productions.produce(reduction.production, reduction.product);
+         }
+      }
+      reductions.resize(reduction_base);
+
+      /*
+         Como en ParseTable::parse(), un texto que no se pudo seguir se
+         prueba terminado en cada posición anotada, de la última a la
+         primera.
+      */
+      while(!result && !ends.empty())
+      {
+         uint64_t end_pos = pos;
+         if(parse(text, end_pos, ends.back(), false))
+         {
+            pos = end_pos;
+            result = true;
+         }
+         ends.pop_back();
+      }
+
+      return result;
+   }
+
+   void PredictiveTable::createRows()
+   {
+      const uint32_t end_token = grammar_productions.getTokens().size();
+      const uint32_t columns = end_token + 1;
+      auto& productions = grammar_productions.getProductions();
+
+      /*
+         FIRST de la gramática: como no coincide sin avanzar, son los
+         primeros terminales de las reglas que no empiezan con ella. FIRST
+         de la continuación: lo que sigue a la gramática en las que sí.
+      */
+      vector<bool> first(columns);
+      for(auto& production : productions)
+      {
+         if(production.symbols[0] != GrammarProductions::NONTERMINAL)
+         {
+            first[production.symbols[0]] = true;
+         }
+      }
+
+      auto addSymbol = [&](vector<bool>& set, int32_t symbol) {
+         if(symbol == GrammarProductions::NONTERMINAL)
+         {
+            for(uint32_t token = 0; token < end_token; ++token)
+            {
+               set[token] = set[token] || first[token];
+            }
+         }
+         else set[symbol] = true;
+      };
+
+      vector<bool> continuation_first(columns);
+      for(auto& production : productions)
+      {
+         if(production.symbols[0] == GrammarProductions::NONTERMINAL)
+         {
+            addSymbol(continuation_first, production.symbols[1]);
+         }
+      }
+
+      /*
+         FOLLOW de la gramática, que es también el de la continuación: el
+         final del texto, lo que sigue a cada llamada a la gramática y, si
+         una regla termina con ella, lo que puede continuarla.
+      */
+      vector<bool> follow(columns);
+      follow[end_token] = true;
+      for(auto& production : productions)
+      {
+         auto& symbols = production.symbols;
+         uint32_t i = symbols[0] == GrammarProductions::NONTERMINAL ? 1 : 0;
+         for(; i < symbols.size(); ++i)
+         {
+            if(symbols[i] != GrammarProductions::NONTERMINAL)
+            {
+               continue;
+            }
+
+            if(i + 1 < symbols.size())
+            {
+               addSymbol(follow, symbols[i + 1]);
+            }
+            else
+            {
+               for(uint32_t token = 0; token < end_token; ++token)
+               {
+                  follow[token] = follow[token] || continuation_first[token];
+               }
+            }
+         }
+      }
+
+      /*
+         Cada celda se queda con la primera producción que la usa; las
+         demás son conflictos.
+      */
+      actions.assign(2 * columns, NO_ACTION);
+      auto setAction = [&](Row row, uint32_t token, int32_t action) {
+         int32_t& cell = actions[row * columns + token];
+         if(cell == NO_ACTION)
+         {
+            cell = action;
+         }
+         else if(cell != action)
+         {
+            addConflict(getActionRule(cell), getActionRule(action), row == CONTINUATION_ROW, false);
+         }
+      };
+
+      for(uint32_t p = 0; p < productions.size(); ++p)
+      {
+         auto& symbols = productions[p].symbols;
+         if(symbols[0] != GrammarProductions::NONTERMINAL)
+         {
+            setAction(GRAMMAR_ROW, symbols[0], p);
+            continue;
+         }
+
+         vector<bool> predict(columns);
+         addSymbol(predict, symbols[1]);
+         for(uint32_t token = 0; token < end_token; ++token)
+         {
+            if(predict[token])
+            {
+               setAction(CONTINUATION_ROW, token, p);
+            }
+         }
+      }
+
+      for(uint32_t token = 0; token < columns; ++token)
+      {
+         if(follow[token])
+         {
+            setAction(CONTINUATION_ROW, token, END_CONTINUATION);
+         }
+      }
+
+      /*
+         Los terminales se prueban en orden y se usa el primero que
+         coincide, así que dos terminales de una fila que llevan a
+         producciones distintas no pueden empezar con el mismo byte.
+      */
+      for(auto row : { GRAMMAR_ROW, CONTINUATION_ROW })
+      {
+         auto& tokens = row_tokens[row];
+         for(uint32_t token = 0; token < end_token; ++token)
+         {
+            int32_t action = actions[row * columns + token];
+            if(action == NO_ACTION)
+            {
+               continue;
+            }
+
+            for(auto other : tokens)
+            {
+               int32_t other_action = actions[row * columns + other];
+               if(other_action != action && grammar_productions.canOverlap(other, token))
+               {
+                  if(other_action == END_CONTINUATION)
+                  {
+                     addConflict(getActionRule(action), nullptr, true, true);
+                  }
+                  else addConflict(getActionRule(other_action), getActionRule(action), row == CONTINUATION_ROW, true);
+               }
+            }
+
+            tokens.push_back(token);
+         }
+      }
+   }
+
+   void PredictiveTable::addConflict(const LanguageExpression* rule, const LanguageExpression* other, bool continuation, bool overlap)
+   {
+      for(auto& conflict : conflicts)
+      {
+         if(conflict.rule == rule && conflict.other == other && conflict.continuation == continuation && conflict.overlap == overlap)
+         {
+            return;
+         }
+      }
+
+      conflicts.push_back({ rule, other, continuation, overlap });
+   }
+
+   const LanguageExpression* PredictiveTable::getActionRule(int32_t action) const
+   {
+      if(action < 0)
+      {
+         return nullptr;
+      }
+
+      return grammar_productions.getProductions()[action].rule;
+   }
+}
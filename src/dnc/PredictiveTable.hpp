@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "GrammarProductions.hpp"
+
+namespace dnc
+{
+   /*
+      Tabla LL(1) de las producciones de una gramática (ver
+      GrammarProductions). Sin recursión a izquierda, cada análisis de la
+      gramática es una regla que empieza con un terminal seguida de una
+      continuación, que aplica una regla que empieza con la gramática y
+      vuelve a continuar o termina. Cada paso se elige con el terminal
+      siguiente según los conjuntos FIRST y FOLLOW, y se analiza con una
+      pila propia, sin probar reglas ni volver atrás.
+   */
+   class PredictiveTable
+   {
+   public:
+      /*
+         Dos reglas que se eligen con el mismo terminal, al comienzo de la
+         gramática o al continuarla (continuation). Si other es nullptr, el
+         terminal puede continuar con rule y también seguir a la gramática,
+         así que no se sabe si la continuación termina.
+
+         Si overlap es true, los terminales son distintos pero pueden
+         empezar con el mismo byte, así que el terminal siguiente depende
+         del orden en que se prueban.
+      */
+      struct Conflict
+      {
+         const LanguageExpression* rule;
+         const LanguageExpression* other;
+         bool continuation;
+         bool overlap;
+      };
+
+      PredictiveTable();
+      ~PredictiveTable();
+
+      /*
+         Falla si las reglas no forman producciones.
+      */
+      bool create(const LanguageExpression* grammar, const std::vector<const LanguageExpression*>& rules);
+      void clear();
+
+      const std::vector<Conflict>& getConflicts() const;
+      uint32_t getTokenCount() const;
+
+      /*
+         Con conflictos no acepta ningún texto. Si el texto se acepta, llama
+         a la función de fábrica de cada regla después de las de sus
+         operandos. Si ignore_rest es true, se acepta el comienzo más largo
+         del texto que termina después de un terminal; si el análisis no
+         puede seguir, se repite terminado en la última posición donde la
+         gramática podía terminar.
+      */
+      bool parse(std::string_view text, uint64_t& pos, uint64_t last_pos, bool ignore_rest) const;
+
+   private:
+      /*
+         Fila de la gramática y fila de la continuación. En cada una, la
+         columna de un terminal (o la del final del texto) tiene la
+         producción que se aplica, NO_ACTION o, en la continuación,
+         END_CONTINUATION.
+      */
+      enum Row
+      {
+         GRAMMAR_ROW,
+         CONTINUATION_ROW
+      };
+
+      static const int32_t NO_ACTION;
+      static const int32_t END_CONTINUATION;
+
+      enum EntryType
+      {
+         TOKEN,
+         GRAMMAR,
+         CONTINUATION,
+         PRODUCE
+      };
+
+      /*
+         Una continuación y la producción que se completa guardan dónde
+         empieza lo ya analizado.
+      */
+      struct Entry
+      {
+         EntryType type;
+         uint32_t value;
+         uint64_t begin;
+      };
+
+      struct Reduction
+      {
+         uint32_t production;
+         ParseProduct product;
+      };
+
+      GrammarProductions grammar_productions;
+      std::vector<int32_t> actions;
+      /*
+         Terminales que se prueban en cada fila, en el orden en que
+         aparecen en las reglas.
+      */
+      std::vector<uint32_t> row_tokens[2];
+      std::vector<Conflict> conflicts;
+
+      void createRows();
+      void addConflict(const LanguageExpression* rule, const LanguageExpression* other, bool continuation, bool overlap);
+      const LanguageExpression* getActionRule(int32_t action) const;
+   };
+}
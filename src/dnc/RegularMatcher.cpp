@@ -0,0 +1,1024 @@
+#include "RegularMatcher.hpp"
+
+#include <algorithm>
+
+#include "UTF8Analyzer.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   namespace
+   {
+      const uint8_t ENTERED = 1;
+      const uint8_t STAGE = 2;
+      const uint8_t SIDE = 4;
+      const uint8_t FOUND = 8;
+
+      const uint8_t RUNNING = 1;
+      const uint8_t FRACTION = 2;
+      const uint8_t DONE = 3;
+
+      uint8_t getCharLength(uint8_t lead)
+      {
+         if(lead < 0x80) return 1;
+         if(lead < 0xE0) return 2;
+         if(lead < 0xF0) return 3;
+         if(lead < 0xF7) return 4;
+         return 0;
+      }
+
+      bool isContinuation(uint8_t c)
+      {
+         return c >= 0x80 && c < 0xC0;
+      }
+
+      uint8_t getPrefixByte(uint32_t prefix, uint8_t index)
+      {
+         return (prefix >> (24 - 8 * index)) & 0xFF;
+      }
+
+      /*
+         Decodifica los bytes conocidos del prefijo, completando los que
+         faltan con el byte de continuación 'fill'.
+      */
+      uint32_t decodePrefix(uint32_t prefix, uint8_t known, uint8_t length, uint8_t fill)
+      {
+         uint8_t lead = getPrefixByte(prefix, 0);
+         uint32_t value = 0;
+
+         if(length == 2) value = lead & 0x1F;
+         else if(length == 3) value = lead & 0x0F;
+         else value = lead & 0x07;
+
+         for(uint8_t i = 1; i < length; ++i)
+         {
+            uint8_t c = i < known ? getPrefixByte(prefix, i) : fill;
+            value = (value << 6) | (c & 0x3F);
+         }
+
+         return value;
+      }
+
+      bool isCanonical(uint32_t prefix, uint8_t length)
+      {
+         uint8_t c0 = getPrefixByte(prefix, 0);
+         uint8_t c1 = getPrefixByte(prefix, 1);
+
+         if(length == 2) return c0 >= 0xC2;
+         if(length == 3) return c0 != 0xE0 || c1 >= 0xA0;
+         return c0 != 0xF0 || c1 >= 0x90;
+      }
+   }
+
+   const uint32_t RegularMatcher::MAX_COUNT = 0xFFFE;
+   const uint32_t RegularMatcher::MAX_CHAR_CODE = 0x1FFFFF;
+
+   const int32_t RegularMatcher::FAIL = -1;
+   const int32_t RegularMatcher::MATCH = -2;
+   const int32_t RegularMatcher::UNKNOWN = -3;
+
+   const uint32_t RegularMatcher::NON_CANONICAL = 0x80000000;
+   const uint32_t RegularMatcher::INVALID_CHAR = 0xFFFFFFFE;
+   const uint32_t RegularMatcher::END_OF_TEXT = 0xFFFFFFFF;
+
+   const uint32_t RegularMatcher::EAGER_STATE_LIMIT = 512;
+   const uint32_t RegularMatcher::LAZY_STATE_LIMIT = 8192;
+   const uint32_t RegularMatcher::BLOCK_STATE_COUNT = 32;
+
+   /*
+      struct RegularMatcher::Atom
+   */
+   RegularMatcher::Atom::Atom() :
+      type(CLASS)
+   {}
+
+   RegularMatcher::Atom::Atom(Type type, const CharClass& chars, bool by_value) :
+      type(type),
+      chars(chars)
+   {
+      if(by_value)
+      {
+         value_chars = chars;
+      }
+   }
+
+   void RegularMatcher::Atom::addClass(const Atom& atom)
+   {
+      chars.addClass(atom.chars);
+      value_chars.addClass(atom.value_chars);
+   }
+
+   void RegularMatcher::Atom::intersectClass(const Atom& atom)
+   {
+      chars.intersectClass(atom.chars);
+      value_chars.intersectClass(atom.value_chars);
+   }
+
+   void RegularMatcher::Atom::negateClass()
+   {
+      chars.complement(MAX_CHAR_CODE);
+      value_chars.complement(MAX_CHAR_CODE);
+   }
+
+   bool RegularMatcher::Atom::checkChar(string_view text, uint64_t& pos) const
+   {
+      uint8_t c = text[pos];
+      if(c < 128)
+      {
+         if(chars.contains(c))
+         {
+            pos += 1;
+            return true;
+         }
+         return false;
+      }
+
+      int char_count;
+      if(!UTF8Analyzer::countNextChar(text, char_count, pos))
+      {
+         return false;
+      }
+
+      uint32_t char_code;
+      if(!UTF8Analyzer::getCharCode(text, pos, char_code))
+      {
+         return false;
+      }
+
+      bool canonical = UTF8Analyzer::isCanonical(text, pos, char_count);
+      if(!(canonical ? chars : value_chars).contains(char_code))
+      {
+         return false;
+      }
+
+      pos += char_count;
+      return true;
+   }
+
+   /*
+      struct RegularMatcher::Item
+   */
+   RegularMatcher::Item::Item() :
+      type(GUARD),
+      min(1),
+      max(-1),
+      ignore(false)
+   {}
+
+   RegularMatcher::Item::Item(Type type, const Atom& first) :
+      type(type),
+      first(first),
+      min(1),
+      max(-1),
+      ignore(false)
+   {}
+
+   RegularMatcher::Item::Item(Type type, const Atom& first, const Atom& second) :
+      type(type),
+      first(first),
+      second(second),
+      min(1),
+      max(-1),
+      ignore(false)
+   {}
+
+   /*
+      class RegularMatcher
+   */
+   RegularMatcher::RegularMatcher(Program&& program) :
+      program(move(program)),
+      blocks(LAZY_STATE_LIMIT / BLOCK_STATE_COUNT + 2, { nullptr, nullptr }),
+      state_count(0),
+      given_up(false),
+      complete(false)
+   {
+      /*
+         Todos los códigos que caen entre dos límites consecutivos se
+         comportan igual en cada una de las clases del programa.
+      */
+      boundaries = { '.', '.' + 1, '0', '9' + 1 };
+      for(auto& item : this->program)
+      {
+         for(auto chars : { &item.first.chars, &item.first.value_chars, &item.second.chars, &item.second.value_chars })
+         {
+            for(auto& range : chars->getRanges())
+            {
+               boundaries.push_back(range.min);
+               if(range.max < MAX_CHAR_CODE)
+               {
+                  boundaries.push_back(range.max + 1);
+               }
+            }
+         }
+      }
+      sort(boundaries.begin(), boundaries.end());
+      boundaries.erase(unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+      start_state = getBoundaryState(getConfig({ 0, 0, 0, 0 }));
+      buildComplete();
+   }
+
+   RegularMatcher::~RegularMatcher()
+   {
+      freeBlocks();
+   }
+
+   RegularMatcher::Result RegularMatcher::match(string_view text, uint64_t pos, uint64_t last_pos, uint64_t& end_pos) const
+   {
+      if(last_pos > text.size())
+      {
+         last_pos = text.size();
+      }
+      if(last_pos < pos)
+      {
+         last_pos = pos;
+      }
+
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+      if(!complete)
+      {
+         if(given_up.load(memory_order_relaxed))
+         {
+            return UNDECIDED;
+         }
+
+         return matchLazy(data, pos, last_pos, end_pos);
+      }
+
+      int32_t state = start_state;
+      for(uint64_t i = pos; i < last_pos; ++i)
+      {
+         int32_t next = transitions[uint32_t(state) * 256 + data[i]];
+         if(next < 0)
+         {
+            if(next == MATCH)
+            {
+               end_pos = i - states[state].offset;
+               return SUCCESS;
+            }
+            return FAILURE;
+         }
+
+         state = next;
+      }
+
+      UTF8Analyzer::setEndReached();
+
+      if(states[state].at_end == MATCH)
+      {
+         end_pos = last_pos - states[state].offset;
+         return SUCCESS;
+      }
+
+      return FAILURE;
+   }
+
+   bool RegularMatcher::canStart(uint8_t byte) const
+   {
+      int32_t next;
+      if(complete)
+      {
+         next = transitions[uint32_t(start_state) * 256 + byte];
+      }
+      else
+      {
+         if(given_up.load(memory_order_relaxed))
+         {
+            return true;
+         }
+
+         next = getTransition(start_state, byte).load(memory_order_acquire);
+         if(next == UNKNOWN)
+         {
+            next = getLazyTransition(start_state, byte);
+            if(next == UNKNOWN)
+            {
+               return true;
+            }
+         }
+      }
+
+      /*
+         MATCH en el primer byte es una coincidencia vacía.
+      */
+      return next >= 0;
+   }
+
+   bool RegularMatcher::isComplete() const
+   {
+      return complete;
+   }
+
+   uint32_t RegularMatcher::getStateCount() const
+   {
+      if(complete)
+      {
+         return states.size();
+      }
+
+      lock_guard<mutex> lock(cache_mutex);
+      return state_count;
+   }
+
+   void RegularMatcher::buildComplete()
+   {
+      for(uint32_t state = 0; state < state_count; ++state)
+      {
+         if(state_count > EAGER_STATE_LIMIT)
+         {
+            return;
+         }
+
+         for(uint32_t byte = 0; byte < 256; ++byte)
+         {
+            if(getTransition(state, byte).load(memory_order_relaxed) == UNKNOWN)
+            {
+               computeTransition(state, byte);
+            }
+         }
+      }
+
+      complete = true;
+      minimize();
+   }
+
+   void RegularMatcher::minimize()
+   {
+      vector<uint32_t> block(state_count);
+      uint32_t block_count = 0;
+
+      {
+         map<pair<uint32_t, int32_t>, uint32_t> initial_blocks;
+         for(uint32_t state = 0; state < state_count; ++state)
+         {
+            auto key = make_pair(uint32_t(getState(state).offset), getState(state).at_end);
+            auto found = initial_blocks.find(key);
+            if(found == initial_blocks.end())
+            {
+               found = initial_blocks.insert({ key, initial_blocks.size() }).first;
+            }
+            block[state] = found->second;
+         }
+         block_count = initial_blocks.size();
+      }
+
+      while(true)
+      {
+         map<vector<int32_t>, uint32_t> signatures;
+         vector<uint32_t> next_block(state_count);
+
+         for(uint32_t state = 0; state < state_count; ++state)
+         {
+            vector<int32_t> signature(257);
+            signature[0] = block[state];
+            for(uint32_t byte = 0; byte < 256; ++byte)
+            {
+               int32_t target = getTransition(state, byte).load(memory_order_relaxed);
+               signature[byte + 1] = target >= 0 ? int32_t(block[target]) : target;
+            }
+
+            auto found = signatures.find(signature);
+            if(found == signatures.end())
+            {
+               found = signatures.insert({ move(signature), signatures.size() }).first;
+            }
+            next_block[state] = found->second;
+         }
+
+         block = move(next_block);
+         if(signatures.size() == block_count)
+         {
+            break;
+         }
+         block_count = signatures.size();
+      }
+
+      vector<State> minimized_states(block_count);
+      vector<int32_t> minimized_transitions(block_count * 256);
+
+      for(uint32_t state = 0; state < state_count; ++state)
+      {
+         uint32_t id = block[state];
+         minimized_states[id] = getState(state);
+
+         for(uint32_t byte = 0; byte < 256; ++byte)
+         {
+            int32_t target = getTransition(state, byte).load(memory_order_relaxed);
+            minimized_transitions[id * 256 + byte] = target >= 0 ? int32_t(block[target]) : target;
+         }
+      }
+
+      start_state = block[start_state];
+      states = move(minimized_states);
+      transitions = move(minimized_transitions);
+      freeBlocks();
+      state_ids.clear();
+      configs.clear();
+      config_ids.clear();
+   }
+
+   void RegularMatcher::freeBlocks()
+   {
+      for(auto& block : blocks)
+      {
+         delete[] block.states;
+         delete[] block.transitions;
+      }
+
+      blocks.clear();
+      state_count = 0;
+   }
+
+   RegularMatcher::Result RegularMatcher::matchLazy(const uint8_t* data, uint64_t pos, uint64_t last_pos, uint64_t& end_pos) const
+   {
+      int32_t state = start_state;
+
+      for(uint64_t i = pos; i < last_pos; ++i)
+      {
+         int32_t next = getTransition(state, data[i]).load(memory_order_acquire);
+         if(next < 0)
+         {
+            if(next == UNKNOWN)
+            {
+               next = getLazyTransition(state, data[i]);
+               if(next == UNKNOWN)
+               {
+                  return UNDECIDED;
+               }
+            }
+
+            if(next == MATCH)
+            {
+               end_pos = i - getState(state).offset;
+               return SUCCESS;
+            }
+            if(next == FAIL)
+            {
+               return FAILURE;
+            }
+         }
+
+         state = next;
+      }
+
+      UTF8Analyzer::setEndReached();
+
+      const State& last = getState(state);
+      if(last.at_end == MATCH)
+      {
+         end_pos = last_pos - last.offset;
+         return SUCCESS;
+      }
+
+      return FAILURE;
+   }
+
+   int32_t RegularMatcher::getLazyTransition(int32_t state, uint8_t byte) const
+   {
+      lock_guard<mutex> lock(cache_mutex);
+
+      if(given_up.load(memory_order_relaxed))
+      {
+         return UNKNOWN;
+      }
+
+      /*
+         Otro hilo pudo haberla calculado mientras se esperaba el mutex.
+      */
+      int32_t next = getTransition(state, byte).load(memory_order_relaxed);
+      if(next != UNKNOWN)
+      {
+         return next;
+      }
+
+      next = computeTransition(state, byte);
+
+      /*
+         Los estados no se liberan, porque otros hilos pueden estar
+         recorriéndolos, pero ya no se agregan más.
+      */
+      if(state_count > LAZY_STATE_LIMIT)
+      {
+         given_up.store(true, memory_order_relaxed);
+         return UNKNOWN;
+      }
+
+      return next;
+   }
+
+   const RegularMatcher::State& RegularMatcher::getState(int32_t state) const
+   {
+      return blocks[uint32_t(state) / BLOCK_STATE_COUNT].states[uint32_t(state) % BLOCK_STATE_COUNT];
+   }
+
+   atomic<int32_t>& RegularMatcher::getTransition(int32_t state, uint8_t byte) const
+   {
+      return blocks[uint32_t(state) / BLOCK_STATE_COUNT].transitions[(uint32_t(state) % BLOCK_STATE_COUNT) * 256 + byte];
+   }
+
+   int32_t RegularMatcher::computeTransition(int32_t state, uint8_t byte) const
+   {
+      State current = getState(state);
+      int32_t next;
+
+      switch(current.kind)
+      {
+      case State::BOUNDARY:
+      {
+         uint8_t length = getCharLength(byte);
+         if(length == 1)
+         {
+            next = resolve(step(current.config, byte));
+         }
+         else if(length == 0)
+         {
+            next = resolve(current.invalid_outcome);
+         }
+         else
+         {
+            next = advancePartial(current.config, uint32_t(byte) << 24, 1, length);
+         }
+         break;
+      }
+
+      case State::PARTIAL:
+         if(!isContinuation(byte))
+         {
+            next = resolve(current.invalid_outcome);
+         }
+         else
+         {
+            uint32_t prefix = current.prefix | (uint32_t(byte) << (24 - 8 * current.offset));
+            if(current.offset + 1 == current.length)
+            {
+               uint32_t char_code = decodePrefix(prefix, current.length, current.length, 0);
+               if(!isCanonical(prefix, current.length))
+               {
+                  char_code |= NON_CANONICAL;
+               }
+               next = resolve(step(current.config, char_code));
+            }
+            else
+            {
+               next = advancePartial(current.config, prefix, current.offset + 1, current.length);
+            }
+         }
+         break;
+
+      default:
+         if(!isContinuation(byte))
+         {
+            next = resolve(current.invalid_outcome);
+         }
+         else if(current.offset + 1 == current.length)
+         {
+            next = resolve(current.outcome);
+         }
+         else
+         {
+            next = getSkipState(current.outcome, current.invalid_outcome, current.offset + 1, current.length);
+         }
+         break;
+      }
+
+      /*
+         El estado destino ya está completo cuando la transición se publica.
+      */
+      getTransition(state, byte).store(next, memory_order_release);
+      return next;
+   }
+
+   int32_t RegularMatcher::advancePartial(uint32_t config, uint32_t prefix, uint8_t offset, uint8_t length) const
+   {
+      uint32_t min = decodePrefix(prefix, offset, length, 0x80);
+      uint32_t max = decodePrefix(prefix, offset, length, 0xBF);
+      uint8_t lead = getPrefixByte(prefix, 0);
+
+      int32_t outcome;
+      bool uniform;
+
+      if(offset == 1 && (lead == 0xE0 || lead == 0xF0))
+      {
+         uint32_t threshold = lead == 0xE0 ? 0x800 : 0x10000;
+         int32_t canonical_outcome;
+
+         uniform = uniformStep(config, min, threshold - 1, NON_CANONICAL, outcome) &&
+            uniformStep(config, threshold, max, 0, canonical_outcome) &&
+            outcome == canonical_outcome;
+      }
+      else
+      {
+         uniform = uniformStep(config, min, max, isCanonical(prefix, length) ? 0 : NON_CANONICAL, outcome);
+      }
+
+      if(uniform)
+      {
+         return getSkipState(outcome, step(config, INVALID_CHAR), offset, length);
+      }
+
+      return getPartialState(config, prefix, offset, length);
+   }
+
+   int32_t RegularMatcher::resolve(int32_t outcome) const
+   {
+      if(outcome >= 0)
+      {
+         return getBoundaryState(outcome);
+      }
+      return outcome;
+   }
+
+   int32_t RegularMatcher::getBoundaryState(uint32_t config) const
+   {
+      StateKey key(State::BOUNDARY, config, 0, 0);
+      auto found = state_ids.find(key);
+      if(found != state_ids.end())
+      {
+         return found->second;
+      }
+
+      State state;
+      state.kind = State::BOUNDARY;
+      state.offset = 0;
+      state.length = 0;
+      state.config = config;
+      state.prefix = 0;
+      state.outcome = FAIL;
+      state.invalid_outcome = step(config, INVALID_CHAR);
+      state.at_end = step(config, END_OF_TEXT);
+
+      return addState(key, state);
+   }
+
+   int32_t RegularMatcher::getPartialState(uint32_t config, uint32_t prefix, uint8_t offset, uint8_t length) const
+   {
+      StateKey key(State::PARTIAL, config, prefix, (offset << 8) | length);
+      auto found = state_ids.find(key);
+      if(found != state_ids.end())
+      {
+         return found->second;
+      }
+
+      State state;
+      state.kind = State::PARTIAL;
+      state.offset = offset;
+      state.length = length;
+      state.config = config;
+      state.prefix = prefix;
+      state.outcome = FAIL;
+      state.invalid_outcome = step(config, INVALID_CHAR);
+      state.at_end = state.invalid_outcome;
+
+      return addState(key, state);
+   }
+
+   int32_t RegularMatcher::getSkipState(int32_t outcome, int32_t invalid_outcome, uint8_t offset, uint8_t length) const
+   {
+      StateKey key(State::SKIP, outcome, invalid_outcome, (offset << 8) | length);
+      auto found = state_ids.find(key);
+      if(found != state_ids.end())
+      {
+         return found->second;
+      }
+
+      State state;
+      state.kind = State::SKIP;
+      state.offset = offset;
+      state.length = length;
+      state.config = 0;
+      state.prefix = 0;
+      state.outcome = outcome;
+      state.invalid_outcome = invalid_outcome;
+      state.at_end = invalid_outcome;
+
+      return addState(key, state);
+   }
+
+   int32_t RegularMatcher::addState(const StateKey& key, const State& state) const
+   {
+      int32_t id = state_count;
+      StateBlock& block = blocks[id / BLOCK_STATE_COUNT];
+      if(block.states == nullptr)
+      {
+         block.states = new State[BLOCK_STATE_COUNT];
+         block.transitions = new atomic<int32_t>[BLOCK_STATE_COUNT * 256];
+         for(uint32_t i = 0; i < BLOCK_STATE_COUNT * 256; ++i)
+         {
+            block.transitions[i].store(UNKNOWN, memory_order_relaxed);
+         }
+      }
+
+      block.states[id % BLOCK_STATE_COUNT] = state;
+      state_count += 1;
+      state_ids[key] = id;
+      return id;
+   }
+
+   uint32_t RegularMatcher::getConfig(const Config& config) const
+   {
+      uint64_t key = (uint64_t(config.item) << 32) | (config.count << 16) | (config.phase << 8) | config.flags;
+      auto found = config_ids.find(key);
+      if(found != config_ids.end())
+      {
+         return found->second;
+      }
+
+      uint32_t id = configs.size();
+      configs.push_back(config);
+      config_ids[key] = id;
+      return id;
+   }
+
+   /*
+      Reproduce, para un único caracter, lo que harían los comandos a partir
+      de la configuración dada: consumirlo (devuelve la nueva configuración),
+      terminar sin consumirlo (MATCH) o fallar (FAIL).
+   */
+   int32_t RegularMatcher::step(uint32_t config_id, uint32_t char_code) const
+   {
+      Config config = configs[config_id];
+
+      while(config.item < program.size())
+      {
+         const Item& item = program[config.item];
+
+         if(config.phase != 0)
+         {
+            uint8_t phase = continueAtom(currentAtom(config), config.phase, char_code);
+            if(phase != 0)
+            {
+               config.phase = phase;
+               return getConfig(config);
+            }
+
+            config.phase = 0;
+            completeAtom(config);
+            continue;
+         }
+
+         uint8_t phase = 0;
+
+         switch(item.type)
+         {
+         case Item::GUARD:
+            if(char_code == END_OF_TEXT)
+            {
+               return FAIL;
+            }
+            nextItem(config);
+            continue;
+
+         case Item::ATOM:
+            phase = startAtom(item.first, char_code);
+            if(phase == 0)
+            {
+               return FAIL;
+            }
+            break;
+
+         case Item::OPT:
+            if(char_code == END_OF_TEXT)
+            {
+               return FAIL;
+            }
+            phase = startAtom(item.first, char_code);
+            if(phase == 0)
+            {
+               nextItem(config);
+               continue;
+            }
+            break;
+
+         case Item::REP:
+         case Item::REPIF:
+         {
+            if(!(config.flags & ENTERED))
+            {
+               if(char_code == END_OF_TEXT)
+               {
+                  return FAIL;
+               }
+               config.flags |= ENTERED;
+            }
+
+            bool condition = config.flags & STAGE;
+            phase = startAtom(condition ? item.second : item.first, char_code);
+            if(phase == 0)
+            {
+               if(item.type == Item::REPIF && !condition && (config.flags & FOUND) && !item.ignore)
+               {
+                  return FAIL;
+               }
+               if(config.count < item.min)
+               {
+                  return FAIL;
+               }
+               nextItem(config);
+               continue;
+            }
+
+            if(condition)
+            {
+               config.flags |= FOUND;
+               break;
+            }
+
+            if(config.count >= item.max)
+            {
+               return FAIL;
+            }
+            config.count += 1;
+            if(item.max == uint32_t(-1) && config.count > item.min)
+            {
+               config.count = item.min;
+            }
+            break;
+         }
+
+         case Item::OR:
+            if(!(config.flags & ENTERED))
+            {
+               if(char_code == END_OF_TEXT)
+               {
+                  return FAIL;
+               }
+               config.flags |= ENTERED;
+
+               phase = startAtom(item.first, char_code);
+               if(phase == 0)
+               {
+                  phase = startAtom(item.second, char_code);
+                  if(phase == 0)
+                  {
+                     return FAIL;
+                  }
+                  config.flags |= SIDE;
+               }
+               break;
+            }
+
+            phase = startAtom((config.flags & SIDE) ? item.first : item.second, char_code);
+            if(phase == 0)
+            {
+               nextItem(config);
+               continue;
+            }
+            break;
+
+         case Item::XOR:
+            if(char_code == END_OF_TEXT)
+            {
+               return FAIL;
+            }
+            phase = startAtom(item.first, char_code);
+            if(phase == 0)
+            {
+               phase = startAtom(item.second, char_code);
+               if(phase == 0)
+               {
+                  return FAIL;
+               }
+               config.flags |= SIDE;
+            }
+            break;
+         }
+
+         if(phase == DONE)
+         {
+            completeAtom(config);
+         }
+         else
+         {
+            config.phase = phase;
+         }
+
+         return getConfig(config);
+      }
+
+      return MATCH;
+   }
+
+   bool RegularMatcher::uniformStep(uint32_t config_id, uint32_t min, uint32_t max, uint32_t flags, int32_t& outcome) const
+   {
+      outcome = step(config_id, min | flags);
+
+      auto boundary = upper_bound(boundaries.begin(), boundaries.end(), min);
+      for(; boundary != boundaries.end() && *boundary <= max; ++boundary)
+      {
+         if(step(config_id, *boundary | flags) != outcome)
+         {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   const RegularMatcher::Atom& RegularMatcher::currentAtom(const Config& config) const
+   {
+      const Item& item = program[config.item];
+
+      switch(item.type)
+      {
+      case Item::REPIF:
+         return (config.flags & STAGE) ? item.second : item.first;
+
+      case Item::OR:
+         return (bool(config.flags & SIDE) != bool(config.flags & STAGE)) ? item.second : item.first;
+
+      case Item::XOR:
+         return (config.flags & SIDE) ? item.second : item.first;
+
+      default:
+         return item.first;
+      }
+   }
+
+   void RegularMatcher::completeAtom(Config& config) const
+   {
+      switch(program[config.item].type)
+      {
+      case Item::REP:
+         break;
+
+      case Item::REPIF:
+         config.flags ^= STAGE;
+         break;
+
+      case Item::OR:
+         if(config.flags & STAGE)
+         {
+            nextItem(config);
+         }
+         else config.flags |= STAGE;
+         break;
+
+      default:
+         nextItem(config);
+         break;
+      }
+   }
+
+   void RegularMatcher::nextItem(Config& config) const
+   {
+      config.item += 1;
+      config.count = 0;
+      config.phase = 0;
+      config.flags = 0;
+   }
+
+   bool RegularMatcher::inAtom(const Atom& atom, uint32_t char_code)
+   {
+      if(char_code >= INVALID_CHAR)
+      {
+         return false;
+      }
+
+      if(char_code & NON_CANONICAL)
+      {
+         return atom.value_chars.contains(char_code & ~NON_CANONICAL);
+      }
+
+      return atom.chars.contains(char_code);
+   }
+
+   uint8_t RegularMatcher::startAtom(const Atom& atom, uint32_t char_code)
+   {
+      switch(atom.type)
+      {
+      case Atom::CLASS:
+         return inAtom(atom, char_code) ? DONE : 0;
+
+      case Atom::RUN:
+         return inAtom(atom, char_code) ? RUNNING : 0;
+
+      default:
+         return (char_code >= '0' && char_code <= '9') ? RUNNING : 0;
+      }
+   }
+
+   uint8_t RegularMatcher::continueAtom(const Atom& atom, uint8_t phase, uint32_t char_code)
+   {
+      switch(atom.type)
+      {
+      case Atom::CLASS:
+         return 0;
+
+      case Atom::RUN:
+         return inAtom(atom, char_code) ? RUNNING : 0;
+
+      default:
+         if(char_code >= '0' && char_code <= '9')
+         {
+            return phase;
+         }
+         if(char_code == '.' && phase == RUNNING)
+         {
+            return FRACTION;
+         }
+         return 0;
+      }
+   }
+}
\ No newline at end of file
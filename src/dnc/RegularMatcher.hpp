@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <tuple>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "CharClass.hpp"
+
+namespace dnc
+{
+   /*
+      Autómata finito determinista (a nivel de bytes) que reproduce el
+      comportamiento de una secuencia de comandos regular. Si el autómata es
+      pequeño se construye completo y minimizado; si no, los estados se
+      construyen a medida que el texto los necesita. Si hacen falta más de
+      LAZY_STATE_LIMIT estados, el autómata deja de usarse y match()
+      devuelve UNDECIDED desde entonces.
+   */
+   class RegularMatcher
+   {
+   public:
+      struct Atom
+      {
+         enum Type
+         {
+            CLASS,
+            RUN,
+            NUMBER
+         };
+
+         Atom();
+         /*
+            Si by_value es true, los caracteres codificados de forma no
+            canónica también se aceptan según su valor decodificado.
+         */
+         Atom(Type type, const CharClass& chars, bool by_value);
+
+         /*
+            Unión, intersección y negación de clases de un solo carácter.
+         */
+         void addClass(const Atom& atom);
+         void intersectClass(const Atom& atom);
+         void negateClass();
+
+         /*
+            Valida un carácter de la clase decodificándolo una sola vez.
+            Quien llama se asegura de que pos esté dentro del texto.
+         */
+         bool checkChar(std::string_view text, uint64_t& pos) const;
+
+         Type type;
+         CharClass chars;
+         /*
+            Códigos que se aceptan cuando el carácter está codificado de
+            forma no canónica.
+         */
+         CharClass value_chars;
+      };
+
+      struct Item
+      {
+         enum Type
+         {
+            GUARD,
+            ATOM,
+            OPT,
+            REP,
+            REPIF,
+            OR,
+            XOR
+         };
+
+         Item();
+         Item(Type type, const Atom& first);
+         Item(Type type, const Atom& first, const Atom& second);
+
+         Type type;
+         Atom first;
+         Atom second;
+         uint32_t min;
+         uint32_t max;
+         bool ignore;
+      };
+
+      typedef std::vector<Item> Program;
+
+      enum Result
+      {
+         SUCCESS,
+         FAILURE,
+         UNDECIDED
+      };
+
+      static const uint32_t MAX_COUNT;
+      static const uint32_t MAX_CHAR_CODE;
+
+      RegularMatcher(Program&& program);
+      ~RegularMatcher();
+
+      Result match(std::string_view text, uint64_t pos, uint64_t last_pos, uint64_t& end_pos) const;
+
+      /*
+         Indica si una coincidencia no vacía puede empezar con el byte.
+      */
+      bool canStart(uint8_t byte) const;
+
+      bool isComplete() const;
+      uint32_t getStateCount() const;
+
+   private:
+      struct Config
+      {
+         uint32_t item;
+         uint32_t count;
+         uint8_t phase;
+         uint8_t flags;
+      };
+
+      struct State
+      {
+         enum Kind
+         {
+            BOUNDARY,
+            PARTIAL,
+            SKIP
+         };
+
+         Kind kind;
+         uint8_t offset;
+         uint8_t length;
+         uint32_t config;
+         uint32_t prefix;
+         int32_t outcome;
+         int32_t invalid_outcome;
+         int32_t at_end;
+      };
+
+      typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t> StateKey;
+
+      static const int32_t FAIL;
+      static const int32_t MATCH;
+      static const int32_t UNKNOWN;
+
+      static const uint32_t NON_CANONICAL;
+      static const uint32_t INVALID_CHAR;
+      static const uint32_t END_OF_TEXT;
+
+      static const uint32_t EAGER_STATE_LIMIT;
+      static const uint32_t LAZY_STATE_LIMIT;
+      static const uint32_t BLOCK_STATE_COUNT;
+
+      /*
+         Estados del autómata incompleto. Un bloque no se mueve una vez
+         creado y sus transiciones se publican ya calculadas, así que se
+         leen sin el mutex; solo calcular una transición nueva lo toma.
+      */
+      struct StateBlock
+      {
+         State* states;
+         std::atomic<int32_t>* transitions;
+      };
+
+      Program program;
+      std::vector<uint32_t> boundaries;
+
+      mutable std::vector<Config> configs;
+      mutable std::unordered_map<uint64_t, uint32_t> config_ids;
+
+      /*
+         Estados del autómata completo y minimizado.
+      */
+      std::vector<State> states;
+      std::vector<int32_t> transitions;
+
+      mutable std::vector<StateBlock> blocks;
+      mutable uint32_t state_count;
+      mutable std::map<StateKey, int32_t> state_ids;
+      mutable std::mutex cache_mutex;
+      mutable std::atomic<bool> given_up;
+      int32_t start_state;
+      bool complete;
+
+      void buildComplete();
+      void minimize();
+      void freeBlocks();
+
+      Result matchLazy(const uint8_t* data, uint64_t pos, uint64_t last_pos, uint64_t& end_pos) const;
+      /*
+         Devuelve la transición, calculándola si hace falta. Si el autómata
+         supera LAZY_STATE_LIMIT estados, devuelve UNKNOWN y deja de usarse.
+      */
+      int32_t getLazyTransition(int32_t state, uint8_t byte) const;
+
+      const State& getState(int32_t state) const;
+      std::atomic<int32_t>& getTransition(int32_t state, uint8_t byte) const;
+
+      int32_t computeTransition(int32_t state, uint8_t byte) const;
+      int32_t advancePartial(uint32_t config, uint32_t prefix, uint8_t offset, uint8_t length) const;
+      int32_t resolve(int32_t outcome) const;
+
+      int32_t getBoundaryState(uint32_t config) const;
+      int32_t getPartialState(uint32_t config, uint32_t prefix, uint8_t offset, uint8_t length) const;
+      int32_t getSkipState(int32_t outcome, int32_t invalid_outcome, uint8_t offset, uint8_t length) const;
+      int32_t addState(const StateKey& key, const State& state) const;
+
+      uint32_t getConfig(const Config& config) const;
+      int32_t step(uint32_t config_id, uint32_t char_code) const;
+      bool uniformStep(uint32_t config_id, uint32_t min, uint32_t max, uint32_t flags, int32_t& outcome) const;
+
+      const Atom& currentAtom(const Config& config) const;
+      void completeAtom(Config& config) const;
+      void nextItem(Config& config) const;
+
+      static bool inAtom(const Atom& atom, uint32_t char_code);
+      static uint8_t startAtom(const Atom& atom, uint32_t char_code);
+      static uint8_t continueAtom(const Atom& atom, uint8_t phase, uint32_t char_code);
+   };
+}
\ No newline at end of file
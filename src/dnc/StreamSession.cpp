@@ -0,0 +1,361 @@
+#include "StreamSession.hpp"
+
+#include <cerrno>
+#include <vector>
+#include <unistd.h>
+
+#include "Grammar.hpp"
+#include "UTF8Analyzer.hpp"
+
+using namespace std;
+
+namespace dnc
+{
+   const uint32_t StreamSession::CHUNK_SIZE = 65536;
+   const uint32_t StreamSession::DISCARD_MIN = 4096;
+
+   StreamSession::StreamSession(const LanguageExpression& expression) :
+      expression(expression),
+      grammar(dynamic_cast<const Grammar*>(&expression)),
+      has_product_function(false),
+      buffer_begin(0),
+      pos(0),
+      product_begin(0),
+      product_count(0),
+      command_index(0),
+      repetition_count(0),
+      input_finished(false),
+      failed(false),
+      accepted(false)
+   {}
+
+   StreamSession::~StreamSession()
+   {}
+
+   void StreamSession::setProductFunction(const LanguageExpression::FactoryFunction& func)
+   {
+      has_product_function = true;
+      product_function = func;
+   }
+
+   void StreamSession::resetProductFunction()
+   {
+      has_product_function = false;
+   }
+
+   bool StreamSession::write(string_view chunk)
+   {
+      if(failed || input_finished)
+      {
+         return false;
+      }
+
+      buffer.append(chunk);
+      advance();
+
+      return !failed;
+   }
+
+   bool StreamSession::write(const char* data, size_t size)
+   {
+      return write(string_view(data, size));
+   }
+
+   bool StreamSession::read(istream& input, uint32_t chunk_size)
+   {
+      vector<char> chunk(chunk_size);
+      while(input.read(chunk.data(), chunk.size()) || input.gcount() > 0)
+      {
+         if(!write(chunk.data(), input.gcount()))
+         {
+            return false;
+         }
+      }
+
+      if(input.bad())
+      {
+         failed = true;
+         return false;
+      }
+
+      return finish();
+   }
+
+   bool StreamSession::read(int fd, uint32_t chunk_size)
+   {
+      vector<char> chunk(chunk_size);
+      while(true)
+      {
+         ssize_t count = ::read(fd, chunk.data(), chunk.size());
+         if(count < 0)
+         {
+            if(errno == EINTR)
+            {
+               continue;
+            }
+
+            failed = true;
+            return false;
+         }
+
+         if(count == 0)
+         {
+            break;
+         }
+
+         if(!write(chunk.data(), count))
+         {
+            return false;
+         }
+      }
+
+      return finish();
+   }
+
+   bool StreamSession::finish()
+   {
+      if(!input_finished)
+      {
+         input_finished = true;
+         advance();
+      }
+
+      return accepted;
+   }
+
+   bool StreamSession::ok() const
+   {
+      return !failed;
+   }
+
+   bool StreamSession::isFinished() const
+   {
+      return input_finished;
+   }
+
+   uint64_t StreamSession::getPosition() const
+   {
+      return pos;
+   }
+
+   uint64_t StreamSession::getBufferSize() const
+   {
+      return buffer.size();
+   }
+
+   void StreamSession::advance()
+   {
+      while(!failed && !accepted)
+      {
+         switch(step())
+         {
+         case STEP_DONE:
+            break;
+
+         case STEP_WAIT:
+            return;
+
+         case STEP_FAIL:
+            failed = true;
+            return;
+
+         case STEP_END:
+            accepted = true;
+            return;
+         }
+      }
+   }
+
+   StreamSession::StepResult StreamSession::step()
+   {
+      const uint64_t last_pos = buffer.size();
+      const uint64_t init_pos = pos - buffer_begin;
+
+      if((grammar != nullptr || (command_index == 0 && repetition_count == 0)) && init_pos >= last_pos)
+      {
+         if(!input_finished)
+         {
+            return STEP_WAIT;
+         }
+
+         /*
+            Una gramática acepta el texto vacío, igual que Grammar::parse;
+            una expresión necesita al menos una coincidencia.
+         */
+         return grammar != nullptr || product_count > 0 ? STEP_END : STEP_FAIL;
+      }
+
+      LanguageExpression::FactoryCalls calls;
+      auto previous_calls = LanguageExpression::deferred_factory_calls;
+      LanguageExpression::deferred_factory_calls = &calls;
+      UTF8Analyzer::resetEndReached();
+
+      uint64_t current_pos = init_pos;
+      bool command_done = true;
+      StepResult result;
+      bool exceeded;
+      {
+         ParseMemo::Scope memo_scope(expression.getParseMemo());
+         CallStack::Scope call_scope(expression.getCallStack());
+         if(grammar != nullptr)
+         {
+            result = stepGrammar(current_pos);
+         }
+         else result = stepExpression(current_pos, command_done);
+
+         exceeded = call_scope.isExceeded();
+      }
+
+      LanguageExpression::deferred_factory_calls = previous_calls;
+
+      if(exceeded)
+      {
+         return STEP_FAIL;
+      }
+
+      /*
+         Si el análisis llegó al final de lo recibido, el resultado puede
+         cambiar con el resto del texto y el paso se repite más adelante.
+      */
+      if(UTF8Analyzer::isEndReached() && !input_finished)
+      {
+         return STEP_WAIT;
+      }
+
+      if(result != STEP_DONE)
+      {
+         return result;
+      }
+
+      for(auto& call : calls)
+      {
+         (*call.first)(ParseProduct(call.second.begin() + buffer_begin, call.second.end() + buffer_begin));
+      }
+
+      pos = buffer_begin + current_pos;
+
+      if(grammar != nullptr)
+      {
+         /*
+            Una regla que no avanza se repetiría para siempre.
+         */
+         if(current_pos == init_pos)
+         {
+            return STEP_FAIL;
+         }
+
+         report(buffer_begin + init_pos, pos);
+      }
+      else if(!command_done)
+      {
+         repetition_count += 1;
+      }
+      else
+      {
+         repetition_count = 0;
+         if(++command_index == expression.compiled->command_sequence.size())
+         {
+            if(pos == product_begin)
+            {
+               return STEP_FAIL;
+            }
+
+            if(expression.has_factory_function)
+            {
+               expression.factory_function(ParseProduct(product_begin, pos));
+            }
+            report(product_begin, pos);
+
+            product_begin = pos;
+            command_index = 0;
+         }
+      }
+
+      discard();
+      return STEP_DONE;
+   }
+
+   StreamSession::StepResult StreamSession::stepExpression(uint64_t& current_pos, bool& command_done)
+   {
+      auto& commands = expression.compiled->command_sequence;
+      if(commands.size() == 0)
+      {
+         return STEP_FAIL;
+      }
+
+      if(!commands[command_index]->isRepetition())
+      {
+         if(!commands[command_index]->check(buffer, current_pos, buffer.size()))
+         {
+            return STEP_FAIL;
+         }
+
+         return STEP_DONE;
+      }
+
+      /*
+         Un REP() avanza de a una repetición: si el texto no alcanza, solo
+         se repite la última, y las anteriores pueden descartarse.
+      */
+      auto repetition = static_cast<const LanguageExpression::REPCommand*>(commands[command_index]);
+      if(repetition_count == 0 && current_pos >= buffer.size())
+      {
+         UTF8Analyzer::setEndReached();
+         return STEP_FAIL;
+      }
+
+      if(repetition->checkRepetition(buffer, current_pos, buffer.size()))
+      {
+         command_done = false;
+         return STEP_DONE;
+      }
+
+      /*
+         La repetición que no coincide termina el REP() sin avanzar ni dejar
+         llamadas de fábrica.
+      */
+      LanguageExpression::deferred_factory_calls->clear();
+      if(!repetition->isRepeatCountValid(repetition_count))
+      {
+         return STEP_FAIL;
+      }
+
+      return STEP_DONE;
+   }
+
+   StreamSession::StepResult StreamSession::stepGrammar(uint64_t& current_pos)
+   {
+      bool matched;
+      if(product_count == 0)
+      {
+         matched = grammar->parseFirst(buffer, current_pos, buffer.size());
+      }
+      else matched = grammar->parseContinuation(buffer, current_pos, buffer.size());
+
+      return matched ? STEP_DONE : STEP_FAIL;
+   }
+
+   void StreamSession::report(uint64_t begin, uint64_t end)
+   {
+      product_count += 1;
+
+      if(has_product_function)
+      {
+         product_function(ParseProduct(begin, end));
+      }
+   }
+
+   void StreamSession::discard()
+   {
+      /*
+         Lo anterior a pos ya no se revisa. Se borra solo cuando es al menos
+         la mitad del búfer, para no mover el resto en cada paso.
+      */
+      uint64_t consumed = pos - buffer_begin;
+      if(consumed >= DISCARD_MIN && consumed * 2 >= buffer.size())
+      {
+         buffer.erase(0, consumed);
+         buffer_begin = pos;
+      }
+   }
+}
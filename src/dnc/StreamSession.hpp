@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+
+#include "LanguageExpression.hpp"
+#include "ParseProduct.hpp"
+
+namespace dnc
+{
+   class Grammar;
+
+   /*
+      Análisis de un texto que llega por partes. Con una LanguageExpression
+      el texto debe ser una o más coincidencias seguidas de la expresión; con
+      una Grammar, un único análisis de la gramática.
+
+      Cada comando del nivel superior de la expresión (o cada regla de la
+      gramática) se da por terminado cuando su resultado ya no puede cambiar
+      con el texto que falta. Recién entonces se llaman las funciones de
+      fábrica, con posiciones absolutas, y se descarta el texto anterior, que
+      ya no se vuelve a revisar. Un REP() del nivel superior se da por
+      terminado de a una repetición.
+
+      El búfer guarda el texto del comando, la repetición o la regla que
+      todavía no terminó, y ese paso se vuelve a revisar desde su comienzo
+      con cada parte nueva: un comando o una regla muy largos (que no sean
+      repeticiones del nivel superior) necesitan todo su texto en memoria
+      y un tiempo que crece con el cuadrado de su largo.
+   */
+   class StreamSession
+   {
+   public:
+      StreamSession(const LanguageExpression& expression);
+      ~StreamSession();
+
+      /*
+         Se llama con cada coincidencia completa de la expresión o con cada
+         regla de la gramática.
+      */
+      void setProductFunction(const LanguageExpression::FactoryFunction& func);
+      void resetProductFunction();
+
+      /*
+         Agregan texto y analizan todo lo que ya no depende de lo que falta.
+         Devuelven false si el texto ya no puede ser aceptado.
+      */
+      bool write(std::string_view chunk);
+      bool write(const char* data, size_t size);
+
+      /*
+         Leen hasta el final de la entrada y terminan el análisis.
+      */
+      bool read(std::istream& input, uint32_t chunk_size = CHUNK_SIZE);
+      bool read(int fd, uint32_t chunk_size = CHUNK_SIZE);
+
+      /*
+         Indica que el texto terminó. Devuelve si fue aceptado completo.
+      */
+      bool finish();
+
+      bool ok() const;
+      bool isFinished() const;
+
+      uint64_t getPosition() const;
+      uint64_t getBufferSize() const;
+
+      static const uint32_t CHUNK_SIZE;
+
+   private:
+      enum StepResult
+      {
+         STEP_DONE,
+         STEP_WAIT,
+         STEP_FAIL,
+         STEP_END
+      };
+
+      static const uint32_t DISCARD_MIN;
+
+      const LanguageExpression& expression;
+      const Grammar* grammar;
+      bool has_product_function;
+      LanguageExpression::FactoryFunction product_function;
+
+      std::string buffer;
+      uint64_t buffer_begin;
+      uint64_t pos;
+      uint64_t product_begin;
+      uint32_t product_count;
+      uint32_t command_index;
+      uint32_t repetition_count;
+      bool input_finished;
+      bool failed;
+      bool accepted;
+
+      void advance();
+      StepResult step();
+      StepResult stepExpression(uint64_t& current_pos, bool& command_done);
+      StepResult stepGrammar(uint64_t& current_pos);
+
+      void report(uint64_t begin, uint64_t end);
+      void discard();
+   };
+}
@@ -1,9 +1,346 @@
 #include "UTF8Analyzer.hpp"
 
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DNC_UTF8_SIMD
+#endif
+
 using namespace std;
 
 namespace dnc
 {
+	namespace
+	{
+		/*
+			Tablas del algoritmo de Keiser y Lemire: cada par de bytes
+			consecutivos se clasifica con los cuatro bits altos del primero,
+			los cuatro bajos del primero y los cuatro altos del segundo. Un
+			error aparece cuando los tres resultados comparten un bit.
+		*/
+		const uint8_t TOO_SHORT = 1 << 0;
+		const uint8_t TOO_LONG = 1 << 1;
+		const uint8_t OVERLONG_3 = 1 << 2;
+		const uint8_t TOO_LARGE = 1 << 3;
+		const uint8_t SURROGATE = 1 << 4;
+		const uint8_t OVERLONG_2 = 1 << 5;
+		const uint8_t TOO_LARGE_1000 = 1 << 6;
+		const uint8_t OVERLONG_4 = 1 << 6;
+		const uint8_t TWO_CONTS = 1 << 7;
+		const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+		const uint8_t BYTE_1_HIGH[16] = {
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+			TOO_SHORT | OVERLONG_2,
+			TOO_SHORT,
+			TOO_SHORT | OVERLONG_3 | SURROGATE,
+			TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+		};
+
+		const uint8_t BYTE_1_LOW[16] = {
+			CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+			CARRY | OVERLONG_2,
+			CARRY,
+			CARRY,
+			CARRY | TOO_LARGE,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+			CARRY | TOO_LARGE | TOO_LARGE_1000,
+			CARRY | TOO_LARGE | TOO_LARGE_1000
+		};
+
+		const uint8_t BYTE_2_HIGH[16] = {
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+			TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+		};
+
+		bool validateScalar(const uint8_t* data, size_t size, size_t pos)
+		{
+			while(pos < size)
+			{
+				if(pos + 8 <= size)
+				{
+					uint64_t block;
+					memcpy(&block, data + pos, 8);
+					if((block & 0x8080808080808080) == 0)
+					{
+						pos += 8;
+						continue;
+					}
+				}
+
+				uint8_t c = data[pos];
+				if(c < 0x80)
+				{
+					++pos;
+					continue;
+				}
+
+				int count;
+				uint8_t min = 0x80;
+				uint8_t max = 0xBF;
+				if(c < 0xC2) return false;
+				else if(c < 0xE0) count = 1;
+				else if(c < 0xF0)
+				{
+					count = 2;
+					if(c == 0xE0) min = 0xA0;
+					else if(c == 0xED) max = 0x9F;
+				}
+				else if(c < 0xF5)
+				{
+					count = 3;
+					if(c == 0xF0) min = 0x90;
+					else if(c == 0xF4) max = 0x8F;
+				}
+				else return false;
+
+				if(size - pos <= size_t(count)) return false;
+				if(data[pos + 1] < min || data[pos + 1] > max) return false;
+				for(int j = 2; j <= count; ++j)
+				{
+					if(data[pos + j] < 0x80 || data[pos + j] > 0xBF) return false;
+				}
+
+				pos += count + 1;
+			}
+
+			return true;
+		}
+
+		/*
+			Los bloques vectoriales no revisan el último carácter si queda
+			incompleto; se retoma la validación escalar desde su inicio.
+		*/
+		bool validateTail(const uint8_t* data, size_t size, size_t pos)
+		{
+			size_t restart = pos;
+			for(size_t k = 1; k <= 3 && k <= pos; ++k)
+			{
+				uint8_t c = data[pos - k];
+				if(c >= 0xC0)
+				{
+					restart = pos - k;
+					break;
+				}
+				if(c < 0x80) break;
+			}
+
+			return validateScalar(data, size, restart);
+		}
+
+		uint64_t countScalar(const uint8_t* data, size_t size, size_t pos)
+		{
+			uint64_t count = 0;
+			for(; pos < size; ++pos)
+			{
+				count += int8_t(data[pos]) > -65;
+			}
+			return count;
+		}
+
+#ifdef DNC_UTF8_SIMD
+		__attribute__((target("sse4.2")))
+		bool validateSSE(const uint8_t* data, size_t size)
+		{
+			const __m128i byte_1_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH));
+			const __m128i byte_1_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW));
+			const __m128i byte_2_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH));
+			const __m128i low_mask = _mm_set1_epi8(0x0F);
+			const __m128i high_bit = _mm_set1_epi8(char(0x80));
+			const __m128i third_byte = _mm_set1_epi8(char(0xE0 - 0x80));
+			const __m128i fourth_byte = _mm_set1_epi8(char(0xF0 - 0x80));
+			const __m128i incomplete = _mm_setr_epi8(
+				-1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, char(0xEF), char(0xDF), char(0xBF)
+			);
+
+			__m128i error = _mm_setzero_si128();
+			__m128i prev_input = _mm_setzero_si128();
+
+			size_t pos = 0;
+			for(; pos + 16 <= size; pos += 16)
+			{
+				__m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+
+				if(_mm_movemask_epi8(input) == 0)
+				{
+					error = _mm_or_si128(error, _mm_subs_epu8(prev_input, incomplete));
+					prev_input = input;
+					continue;
+				}
+
+				__m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+				__m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+				__m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+				__m128i special = _mm_and_si128(
+					_mm_and_si128(
+						_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), low_mask)),
+						_mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, low_mask))
+					),
+					_mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), low_mask))
+				);
+
+				__m128i must_continue = _mm_and_si128(
+					_mm_or_si128(_mm_subs_epu8(prev2, third_byte), _mm_subs_epu8(prev3, fourth_byte)),
+					high_bit
+				);
+
+				error = _mm_or_si128(error, _mm_xor_si128(must_continue, special));
+				prev_input = input;
+			}
+
+			if(!_mm_testz_si128(error, error)) return false;
+
+			return validateTail(data, size, pos);
+		}
+
+		__attribute__((target("avx2")))
+		bool validateAVX2(const uint8_t* data, size_t size)
+		{
+			const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_HIGH)));
+			const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_1_LOW)));
+			const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(BYTE_2_HIGH)));
+			const __m256i low_mask = _mm256_set1_epi8(0x0F);
+			const __m256i high_bit = _mm256_set1_epi8(char(0x80));
+			const __m256i third_byte = _mm256_set1_epi8(char(0xE0 - 0x80));
+			const __m256i fourth_byte = _mm256_set1_epi8(char(0xF0 - 0x80));
+			const __m256i incomplete = _mm256_setr_epi8(
+				-1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, -1, -1, -1,
+				-1, -1, -1, -1, -1, char(0xEF), char(0xDF), char(0xBF)
+			);
+
+			__m256i error = _mm256_setzero_si256();
+			__m256i prev_input = _mm256_setzero_si256();
+
+			size_t pos = 0;
+			for(; pos + 32 <= size; pos += 32)
+			{
+				__m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+
+				if(_mm256_movemask_epi8(input) == 0)
+				{
+					error = _mm256_or_si256(error, _mm256_subs_epu8(prev_input, incomplete));
+					prev_input = input;
+					continue;
+				}
+
+				/*
+					alignr trabaja por mitades de 128 bits, así que primero se
+					arma el vector con la mitad alta anterior y la baja actual.
+				*/
+				__m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+				__m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+				__m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+				__m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+				__m256i special = _mm256_and_si256(
+					_mm256_and_si256(
+						_mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_mask)),
+						_mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, low_mask))
+					),
+					_mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), low_mask))
+				);
+
+				__m256i must_continue = _mm256_and_si256(
+					_mm256_or_si256(_mm256_subs_epu8(prev2, third_byte), _mm256_subs_epu8(prev3, fourth_byte)),
+					high_bit
+				);
+
+				error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special));
+				prev_input = input;
+			}
+
+			if(!_mm256_testz_si256(error, error)) return false;
+
+			return validateTail(data, size, pos);
+		}
+
+		__attribute__((target("sse4.2,popcnt")))
+		uint64_t countSSE(const uint8_t* data, size_t size)
+		{
+			const __m128i limit = _mm_set1_epi8(-65);
+
+			uint64_t count = 0;
+			size_t pos = 0;
+			for(; pos + 16 <= size; pos += 16)
+			{
+				__m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+				count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(input, limit)));
+			}
+
+			return count + countScalar(data, size, pos);
+		}
+
+		__attribute__((target("avx2,popcnt")))
+		uint64_t countAVX2(const uint8_t* data, size_t size)
+		{
+			const __m256i limit = _mm256_set1_epi8(-65);
+
+			uint64_t count = 0;
+			size_t pos = 0;
+			for(; pos + 32 <= size; pos += 32)
+			{
+				__m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+				count += __builtin_popcount(uint32_t(_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, limit))));
+			}
+
+			return count + countScalar(data, size, pos);
+		}
+#endif
+
+		bool validateDefault(const uint8_t* data, size_t size)
+		{
+			return validateScalar(data, size, 0);
+		}
+
+		uint64_t countDefault(const uint8_t* data, size_t size)
+		{
+			return countScalar(data, size, 0);
+		}
+
+		typedef bool (*ValidateFunction)(const uint8_t*, size_t);
+		typedef uint64_t (*CountFunction)(const uint8_t*, size_t);
+
+		ValidateFunction selectValidate()
+		{
+#ifdef DNC_UTF8_SIMD
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx2")) return validateAVX2;
+			if(__builtin_cpu_supports("sse4.2")) return validateSSE;
+#endif
+			return validateDefault;
+		}
+
+		CountFunction selectCount()
+		{
+#ifdef DNC_UTF8_SIMD
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) return countAVX2;
+			if(__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) return countSSE;
+#endif
+			return countDefault;
+		}
+	}
+
 	const uint8_t UTF8Analyzer::ASCII_HEADER_MIN = 0;
 	const uint8_t UTF8Analyzer::ASCII_HEADER_MAX = 128;
 	const uint8_t UTF8Analyzer::TWO_BYTES_HEADER_MAX = 224;
@@ -12,12 +349,20 @@ namespace dnc
 	const uint8_t UTF8Analyzer::NEXT_BYTE_HEADER_MIN = 128;
 	const uint8_t UTF8Analyzer::NEXT_BYTE_HEADER_MAX = 192;
 
+	thread_local const char* UTF8Analyzer::validated_data = nullptr;
+	thread_local size_t UTF8Analyzer::validated_size = 0;
+	thread_local bool UTF8Analyzer::end_reached = false;
+
 	UTF8Analyzer::UTF8Analyzer()
 	{}
 
-	bool UTF8Analyzer::countNextChar(const string& utf8_chars, int& target, uint32_t pos)
+	bool UTF8Analyzer::countNextChar(string_view utf8_chars, int& target, uint64_t pos)
 	{
-		if(pos >= utf8_chars.size()) return false;
+		if(pos >= utf8_chars.size())
+		{
+			end_reached = true;
+			return false;
+		}
 		
 		uint8_t c = utf8_chars[pos];
 		
@@ -26,6 +371,15 @@ namespace dnc
 			target = 1;
 			return true;
 		}
+		else if(c >= NEXT_BYTE_HEADER_MAX && isValidated(utf8_chars))
+		{
+			/*
+				En un texto ya validado, todo byte inicial va seguido de sus
+				bytes de continuación.
+			*/
+			target = 2 + (c >= TWO_BYTES_HEADER_MAX) + (c >= THREE_BYTES_HEADER_MAX);
+			return true;
+		}
 		else if(c < TWO_BYTES_HEADER_MAX)
 		{
 			++pos;
@@ -57,9 +411,13 @@ namespace dnc
 		return false;
 	}
 
-	bool UTF8Analyzer::readNextByte(const string& utf8_chars, uint32_t pos)
+	bool UTF8Analyzer::readNextByte(string_view utf8_chars, uint64_t pos)
 	{
-		if(pos >= utf8_chars.size()) return false;
+		if(pos >= utf8_chars.size())
+		{
+			end_reached = true;
+			return false;
+		}
 
 		uint8_t c = utf8_chars[pos];
 		
@@ -71,9 +429,13 @@ namespace dnc
 		return false;
 	}
 
-	bool UTF8Analyzer::getCharCode(const string& utf8_chars, uint32_t pos, uint32_t& char_code)
+	bool UTF8Analyzer::getCharCode(string_view utf8_chars, uint64_t pos, uint32_t& char_code)
 	{
-		if(pos >= utf8_chars.size()) return false;
+		if(pos >= utf8_chars.size())
+		{
+			end_reached = true;
+			return false;
+		}
 
 		int char_large;
 		if(!countNextChar(utf8_chars, char_large, pos))
@@ -98,7 +460,7 @@ namespace dnc
 			char_code = c0 | c1;
 			return true;
 		}
-		else if(char_code == 3)
+		else if(char_large == 3)
 		{
 			uint16_t c0 = utf8_chars[pos];
 			uint16_t c1 = utf8_chars[pos + 1];
@@ -159,10 +521,10 @@ namespace dnc
 			result.push_back(y);
 			result.push_back(x);
 		}
-		else if(char_code < 0x100000)
+		else if(char_code < 0x110000)
 		{
 			char u = 0b11110000 | ((char_code & 0b111000000000000000000) >> 18);
-			char z = 0b10000000 | ((char_code & 0b1111110000000000) >> 12);
+			char z = 0b10000000 | ((char_code & 0b111111000000000000) >> 12);
 			char y = 0b10000000 | ((char_code & 0b111111000000) >> 6);
 			char x = 0b10000000 | (char_code & 0b111111);
 
@@ -174,4 +536,95 @@ namespace dnc
 
 		return result;
 	}
-}
\ No newline at end of file
+
+	bool UTF8Analyzer::isCanonical(string_view utf8_chars, uint64_t pos, int char_count)
+	{
+		uint8_t c0 = utf8_chars[pos];
+
+		if(char_count == 1)
+		{
+			return true;
+		}
+		else if(char_count == 2)
+		{
+			return c0 >= 0xC2;
+		}
+
+		uint8_t c1 = utf8_chars[pos + 1];
+
+		if(char_count == 3)
+		{
+			return c0 != 0xE0 || c1 >= 0xA0;
+		}
+
+		return (c0 != 0xF0 || c1 >= 0x90) && (c0 < 0xF4 || (c0 == 0xF4 && c1 < 0x90));
+	}
+
+	bool UTF8Analyzer::validate(string_view utf8_chars)
+	{
+		return validate(utf8_chars.data(), utf8_chars.size());
+	}
+
+	bool UTF8Analyzer::validate(const char* data, size_t size)
+	{
+		static const ValidateFunction function = selectValidate();
+		return function(reinterpret_cast<const uint8_t*>(data), size);
+	}
+
+	uint64_t UTF8Analyzer::countChars(string_view utf8_chars)
+	{
+		return countChars(utf8_chars.data(), utf8_chars.size());
+	}
+
+	uint64_t UTF8Analyzer::countChars(const char* data, size_t size)
+	{
+		static const CountFunction function = selectCount();
+		return function(reinterpret_cast<const uint8_t*>(data), size);
+	}
+
+	bool UTF8Analyzer::isValidated(string_view utf8_chars)
+	{
+		return utf8_chars.data() == validated_data && utf8_chars.size() == validated_size;
+	}
+
+	/*
+		class UTF8Analyzer::ValidatedInput
+	*/
+	UTF8Analyzer::ValidatedInput::ValidatedInput(string_view utf8_chars) :
+		previous_data(validated_data),
+		previous_size(validated_size),
+		valid(validate(utf8_chars))
+	{
+		if(valid)
+		{
+			validated_data = utf8_chars.data();
+			validated_size = utf8_chars.size();
+		}
+	}
+
+	UTF8Analyzer::ValidatedInput::~ValidatedInput()
+	{
+		validated_data = previous_data;
+		validated_size = previous_size;
+	}
+
+	bool UTF8Analyzer::ValidatedInput::isValid() const
+	{
+		return valid;
+	}
+
+	void UTF8Analyzer::setEndReached()
+	{
+		end_reached = true;
+	}
+
+	void UTF8Analyzer::resetEndReached()
+	{
+		end_reached = false;
+	}
+
+	bool UTF8Analyzer::isEndReached()
+	{
+		return end_reached;
+	}
+}
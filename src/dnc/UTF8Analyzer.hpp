@@ -1,16 +1,64 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace dnc
 {
    class UTF8Analyzer
    {
    public:
-      static bool countNextChar(const std::string& utf8_chars, int& target, uint32_t pos);
-      static bool readNextByte(const std::string& utf8_chars, uint32_t pos);
-      static bool getCharCode(const std::string& utf8_chars, uint32_t pos, uint32_t& char_code);
+      static bool countNextChar(std::string_view utf8_chars, int& target, uint64_t pos);
+      static bool readNextByte(std::string_view utf8_chars, uint64_t pos);
+      static bool getCharCode(std::string_view utf8_chars, uint64_t pos, uint32_t& char_code);
       static std::string getChar(uint32_t char_code);
+      static bool isCanonical(std::string_view utf8_chars, uint64_t pos, int char_count);
+
+      /*
+         Validación y conteo de un búfer completo. Se usan instrucciones
+         AVX2 o SSE4.2 si el procesador las tiene; si no, la versión escalar.
+         La validación es estricta (sin secuencias sobrelargas, sustitutos ni
+         códigos mayores a U+10FFFF), y el conteo cuenta los bytes que no son
+         de continuación.
+      */
+      static bool validate(std::string_view utf8_chars);
+      static bool validate(const char* data, size_t size);
+      static uint64_t countChars(std::string_view utf8_chars);
+      static uint64_t countChars(const char* data, size_t size);
+
+      /*
+         Valida el texto y, si es válido, lo marca como tal en el hilo actual
+         mientras dure el ámbito. Sobre un texto marcado countNextChar ya no
+         revisa los bytes de continuación. El texto no debe modificarse
+         mientras el ámbito exista.
+      */
+      class ValidatedInput
+      {
+      public:
+         ValidatedInput(std::string_view utf8_chars);
+         ~ValidatedInput();
+
+         bool isValid() const;
+
+      private:
+         const char* previous_data;
+         size_t previous_size;
+         bool valid;
+      };
+
+      static bool isValidated(std::string_view utf8_chars);
+
+      /*
+         Marca del hilo actual que indica si algún análisis comparó una
+         posición con el final del texto y el resultado dependió de ello. Los
+         análisis por partes la usan para saber si un resultado puede cambiar
+         cuando llegue más texto.
+      */
+      static void setEndReached();
+      static void resetEndReached();
+      static bool isEndReached();
 
    private:
       UTF8Analyzer();
@@ -22,5 +70,9 @@ namespace dnc
       static const uint8_t FOUR_BYTES_HEADER_MAX;
       static const uint8_t NEXT_BYTE_HEADER_MIN;
       static const uint8_t NEXT_BYTE_HEADER_MAX;
+
+      static thread_local const char* validated_data;
+      static thread_local size_t validated_size;
+      static thread_local bool end_reached;
    };
 }
\ No newline at end of file
@@ -31,7 +31,7 @@ namespace dnc
    UTF8Tokenizator::UTF8Tokenizator()
    {}
 
-   TextStatus UTF8Tokenizator::getToken(const string& text, uint32_t pos, TextToken& target)
+   TextStatus UTF8Tokenizator::getToken(string_view text, uint64_t pos, TextToken& target)
    {
       int32_t char_count = 0;
       if(!UTF8Analyzer::countNextChar(text, char_count, pos))
@@ -49,7 +49,6 @@ namespace dnc
          case C_BLANK:
          {
             target.type = TextToken::SPACE;
-            target.value = text.substr(pos, char_count);
             target.char_count = 1;
 
             auto pos2 = pos + 1;
@@ -58,26 +57,30 @@ namespace dnc
                int32_t char_count_2 = 0;
                if(!UTF8Analyzer::countNextChar(text, char_count_2, pos2))
                {
-                  return TextStatus();
+                  break;
                }
 
                if(char_count_2 > 1)
                {
-                  return TextStatus();
+                  break;
                }
 
                uint8_t c2 = text[pos2];
                if(CHAR_TYPES[c2] != C_BLANK)
                {
-                  return TextStatus();
+                  break;
                }
 
-               target.value += text.substr(pos2, char_count_2);
                target.char_count += 1;
                ++pos2;
             }
 
-            break;
+            /*
+               Los caracteres de la secuencia ocupan un byte cada uno, así que
+               el valor se copia una sola vez al final.
+            */
+            target.value.assign(text.substr(pos, pos2 - pos));
+            return TextStatus();
          }
 
          case C_SYMBOL:
@@ -91,7 +94,6 @@ namespace dnc
          case C_NUMBER:
          {
             target.type = TextToken::NUMBER;
-            target.value = text.substr(pos, char_count);
             target.char_count = 1;
 
             bool added_point = false;
@@ -102,18 +104,18 @@ namespace dnc
                int32_t char_count_2 = 0;
                if(!UTF8Analyzer::countNextChar(text, char_count_2, pos2))
                {
-                  return TextStatus();
+                  break;
                }
 
                if(char_count_2 > 1)
                {
-                  return TextStatus();
+                  break;
                }
 
                uint8_t c2 = text[pos2];
                if(CHAR_TYPES[c2] != C_NUMBER && CHAR_TYPES[c2] != C_SYMBOL)
                {
-                  return TextStatus();
+                  break;
                }
 
                if(CHAR_TYPES[c2] == C_SYMBOL)
@@ -122,20 +124,19 @@ namespace dnc
                   {
                      added_point = true;
                   }
-                  else return TextStatus();
+                  else break;
                }
 
-               target.value += text.substr(pos2, char_count_2);
                target.char_count += 1;
                ++pos2;
             }
 
-            break;
+            target.value.assign(text.substr(pos, pos2 - pos));
+            return TextStatus();
          }
 
          case C_LETTER:
             target.type = TextToken::WORD;
-            target.value = text.substr(pos, char_count);
             target.char_count = 1;
 
             auto pos2 = pos + 1;
@@ -144,26 +145,26 @@ namespace dnc
                int32_t char_count_2 = 0;
                if(!UTF8Analyzer::countNextChar(text, char_count_2, pos2))
                {
-                  return TextStatus();
+                  break;
                }
 
                if(char_count_2 > 1)
                {
-                  return TextStatus();
+                  break;
                }
 
                uint8_t c2 = text[pos2];
                if(CHAR_TYPES[c2] != C_LETTER)
                {
-                  return TextStatus();
+                  break;
                }
 
-               target.value += text.substr(pos2, char_count_2);
                target.char_count += 1;
                ++pos2;
             }
 
-            break;
+            target.value.assign(text.substr(pos, pos2 - pos));
+            return TextStatus();
          }
       }
 
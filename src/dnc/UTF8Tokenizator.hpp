@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 
 #include "TextStatus.hpp"
 #include "TextToken.hpp"
@@ -19,7 +20,7 @@ namespace dnc
    class UTF8Tokenizator
    {
    public:
-      static TextStatus getToken(const std::string& text, uint32_t pos, TextToken& target);
+      static TextStatus getToken(std::string_view text, uint64_t pos, TextToken& target);
 
    private:
       static const std::vector<CharType> CHAR_TYPES;